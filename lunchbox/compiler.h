@@ -97,6 +97,11 @@
 #define LB_ALIGN16(var) var __attribute__((aligned(16)));
 #endif // GCC
 
+/** Size of a cache line, used to pad data against false sharing. */
+#ifndef LB_CACHELINE_SIZE
+#define LB_CACHELINE_SIZE 64
+#endif
+
 #ifndef LB_UNUSED
 #define LB_UNUSED
 #endif
@@ -0,0 +1,125 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "futex.h"
+
+#ifdef __linux__
+#include <climits>
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace lunchbox
+{
+#ifdef __linux__
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "std::atomic< uint32_t > is not usable as a futex word");
+
+namespace
+{
+inline long _futex(Futex* futex, const int op, const uint32_t value,
+                   const timespec* timeout)
+{
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(futex), op, value,
+                     timeout, nullptr, 0);
+}
+}
+
+bool Futex::wait(const uint32_t expected, const uint32_t timeout)
+{
+    if (timeout == LB_TIMEOUT_INDEFINITE)
+    {
+        _futex(this, FUTEX_WAIT_PRIVATE, expected, nullptr);
+        return true;
+    }
+
+    timespec delta;
+    delta.tv_sec = timeout / 1000;
+    delta.tv_nsec = (timeout % 1000) * 1000000;
+    if (_futex(this, FUTEX_WAIT_PRIVATE, expected, &delta) == 0)
+        return true;
+    return errno != ETIMEDOUT; // EAGAIN: value changed, EINTR: spurious
+}
+
+void Futex::wakeOne()
+{
+    _futex(this, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+void Futex::wakeAll()
+{
+    _futex(this, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+}
+
+#else
+
+namespace
+{
+// Futexes are hashed by address onto a fixed set of condition variables,
+// sleepers on colliding buckets see spurious wakeups.
+struct Bucket
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+#define NBUCKETS 64
+Bucket _buckets[NBUCKETS];
+
+Bucket& _getBucket(const Futex* futex)
+{
+    return _buckets[(reinterpret_cast<size_t>(futex) >> 4) % NBUCKETS];
+}
+}
+
+bool Futex::wait(const uint32_t expected, const uint32_t timeout)
+{
+    Bucket& bucket = _getBucket(this);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (load() != expected)
+        return true;
+
+    if (timeout == LB_TIMEOUT_INDEFINITE)
+    {
+        bucket.condition.wait(lock);
+        return true;
+    }
+    return bucket.condition.wait_for(lock, std::chrono::milliseconds(
+                                               timeout)) ==
+           std::cv_status::no_timeout;
+}
+
+void Futex::wakeOne()
+{
+    wakeAll(); // the bucket may be shared with other futexes
+}
+
+void Futex::wakeAll()
+{
+    Bucket& bucket = _getBucket(this);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    bucket.condition.notify_all();
+}
+#endif
+}
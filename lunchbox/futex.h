@@ -0,0 +1,73 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_FUTEX_H
+#define LUNCHBOX_FUTEX_H
+
+#include <lunchbox/api.h>
+#include <lunchbox/types.h>
+
+#include <atomic>
+
+namespace lunchbox
+{
+/**
+ * An atomic 32 bit word threads can block on until it changes.
+ *
+ * Used to build blocking primitives with a lock-free fast path: modifying the
+ * value is a plain atomic operation, and only threads which need to sleep or
+ * wake sleepers enter the kernel. On Linux this maps directly to a futex,
+ * other platforms use a hashed table of condition variables.
+ *
+ * Like with condition variables, wait() may return spuriously. Callers have to
+ * re-check their condition in a loop.
+ *
+ * Example: @include tests/futex.cpp
+ */
+class Futex : public std::atomic<uint32_t>
+{
+public:
+    /** Construct a new futex with the given value. @version 1.18 */
+    explicit Futex(const uint32_t value = 0)
+        : std::atomic<uint32_t>(value)
+    {
+    }
+
+    using std::atomic<uint32_t>::operator=;
+
+    /**
+     * Block while the value is equal to expected.
+     *
+     * Returns immediately if the value is not equal to expected.
+     *
+     * @param expected the value to sleep on.
+     * @param timeout the timeout in milliseconds, or LB_TIMEOUT_INDEFINITE.
+     * @return false on timeout, true otherwise.
+     * @version 1.18
+     */
+    LUNCHBOX_API bool wait(const uint32_t expected,
+                           const uint32_t timeout = LB_TIMEOUT_INDEFINITE);
+
+    /** Wake up at least one thread blocked in wait(). @version 1.18 */
+    LUNCHBOX_API void wakeOne();
+
+    /** Wake up all threads blocked in wait(). @version 1.18 */
+    LUNCHBOX_API void wakeAll();
+};
+}
+
+#endif // LUNCHBOX_FUTEX_H
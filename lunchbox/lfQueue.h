@@ -20,9 +20,13 @@
 
 #include <lunchbox/atomic.h> // member
 #include <lunchbox/debug.h>  // used in inline method
+#include <lunchbox/futex.h>  // member
 #include <lunchbox/thread.h> // thread-safety checks
 
-#include <vector>
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace lunchbox
 {
@@ -30,6 +34,14 @@ namespace lunchbox
  * A thread-safe, lock-free queue with non-blocking access.
  *
  * Typically used for caches and non-blocking communication between two threads.
+ * Elements are only constructed when pushed and destroyed when popped, which
+ * allows move-only types and makes moving large objects through the queue
+ * cheap.
+ *
+ * The non-blocking methods never enter the kernel. Optionally, the reader may
+ * wait for data using timedPop() and the writer for free space using
+ * timedPush(). A waiting thread spins briefly before it goes to sleep, and
+ * the other side only issues a wakeup when a thread is actually sleeping.
  *
  * Current implementation constraints:
  * * One reader thread
@@ -45,14 +57,17 @@ class LFQueue : public boost::noncopyable
 public:
     /** Construct a new queue. @version 1.0 */
     explicit LFQueue(const int32_t size)
-        : _data(size + 1)
+        : _data(new Storage[size + 1])
+        , _size(size + 1)
         , _readPos(0)
         , _writePos(0)
+        , _readerWaiting(false)
+        , _writerWaiting(false)
     {
     }
 
     /** Destruct this queue. @version 1.0 */
-    ~LFQueue() {}
+    ~LFQueue() { _destroy(); }
     /** @return true if the queue is empty, false otherwise. @version 1.0 */
     bool isEmpty() const { return _readPos == _writePos; }
     /** Reset (empty) the queue. @version 1.0 */
@@ -69,6 +84,8 @@ public:
     /**
      * Retrieve and pop the front element from the queue.
      *
+     * The element is moved into result.
+     *
      * @param result the front value or unmodified
      * @return true if an element was placed in result, false if the queue
      *         is empty.
@@ -76,6 +93,17 @@ public:
      */
     bool pop(T& result);
 
+    /**
+     * Retrieve and pop the front element, waiting for it if necessary.
+     *
+     * @param timeout the time to wait in milliseconds, or
+     *                LB_TIMEOUT_INDEFINITE.
+     * @param result the front value or unmodified
+     * @return true if an element was placed in result, false on timeout.
+     * @version 1.18
+     */
+    bool timedPop(const uint32_t timeout, T& result);
+
     /**
      * Retrieve the front element from the queue.
      *
@@ -93,20 +121,103 @@ public:
      * @return true if the element was placed, false if the queue is full
      * @version 1.0
      */
-    bool push(const T& element);
+    bool push(const T& element) { return emplace(element); }
+    /**
+     * Move a new element to the back of the queue.
+     *
+     * @param element the element to add.
+     * @return true if the element was placed, false if the queue is full
+     * @version 1.18
+     */
+    bool push(T&& element) { return emplace(std::move(element)); }
+    /**
+     * Construct a new element in place at the back of the queue.
+     *
+     * @param args the arguments passed to the element's constructor.
+     * @return true if the element was placed, false if the queue is full, in
+     *         which case no element has been constructed.
+     * @version 1.18
+     */
+    template <typename... Args>
+    bool emplace(Args&&... args);
+
+    /**
+     * Push a new element, waiting for free space if necessary.
+     *
+     * @param timeout the time to wait in milliseconds, or
+     *                LB_TIMEOUT_INDEFINITE.
+     * @param element the element to add.
+     * @return true if the element was placed, false on timeout.
+     * @version 1.18
+     */
+    bool timedPush(const uint32_t timeout, const T& element);
+
+    /**
+     * Move a new element, waiting for free space if necessary.
+     *
+     * @param timeout the time to wait in milliseconds, or
+     *                LB_TIMEOUT_INDEFINITE.
+     * @param element the element to add, unmodified on timeout.
+     * @return true if the element was placed, false on timeout.
+     * @version 1.18
+     */
+    bool timedPush(const uint32_t timeout, T&& element);
+
+    /**
+     * Push a number of elements to the back of the queue.
+     *
+     * The elements are copied as one contiguous run, wrapping around the end
+     * of the ring buffer if needed, and are published to the reader at once.
+     *
+     * @param elements the elements to add.
+     * @param num the number of elements to add.
+     * @return the number of elements placed, which is smaller than num if the
+     *         queue is full.
+     * @version 1.18
+     */
+    size_t push(const T* elements, const size_t num);
+
+    /**
+     * Retrieve and pop a number of elements from the front of the queue.
+     *
+     * The elements are moved into result and released to the writer at once.
+     *
+     * @param result the output array receiving up to maximum elements.
+     * @param maximum the maximum number of elements to retrieve.
+     * @return the number of elements placed in result, 0 if the queue is
+     *         empty.
+     * @version 1.18
+     */
+    size_t pop(T* result, const size_t maximum);
 
     /**
      * @return the maximum number of elements held by the queue.
      * @version 1.0
      */
-    size_t getCapacity() const { return _data.size() - 1; }
+    size_t getCapacity() const { return _size - 1; }
 private:
-    std::vector<T> _data;
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    std::unique_ptr<Storage[]> _data;
+    int32_t _size;
     a_int32_t _readPos;
     a_int32_t _writePos;
 
+    Futex _pushed; // wakes a sleeping reader
+    Futex _popped; // wakes a sleeping writer
+    std::atomic<bool> _readerWaiting;
+    std::atomic<bool> _writerWaiting;
+
     LB_TS_VAR(_reader);
     LB_TS_VAR(_writer);
+
+    T* _get(const int32_t pos) { return reinterpret_cast<T*>(&_data[pos]); }
+    void _destroy();
+
+    template <typename F>
+    bool _wait(Futex& signal, std::atomic<bool>& waiting,
+               const uint32_t timeout, const F& tryOperation);
+    void _signal(Futex& signal, std::atomic<bool>& waiting);
 };
 }
 
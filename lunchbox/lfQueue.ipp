@@ -17,12 +17,75 @@
 
 namespace lunchbox
 {
+template <typename T>
+template <typename F>
+bool LFQueue<T>::_wait(Futex& signal, std::atomic<bool>& waiting,
+                       const uint32_t timeout, const F& tryOperation)
+{
+    const size_t spinCount = 64; // tries before going to sleep
+    for (size_t i = 0; i < spinCount; ++i)
+    {
+        if (tryOperation())
+            return true;
+        lunchbox::Thread::yield();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        // Announce the sleep before the last try, paired with _signal()
+        const uint32_t epoch = signal.load();
+        waiting = true;
+        if (tryOperation())
+        {
+            waiting = false;
+            return true;
+        }
+
+        uint32_t remaining = LB_TIMEOUT_INDEFINITE;
+        if (timeout != LB_TIMEOUT_INDEFINITE)
+        {
+            const auto elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+            if (elapsed >= timeout)
+            {
+                waiting = false;
+                return false;
+            }
+            remaining = timeout - uint32_t(elapsed);
+        }
+        signal.wait(epoch, remaining);
+    }
+}
+
+template <typename T>
+void LFQueue<T>::_signal(Futex& signal, std::atomic<bool>& waiting)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiting.load(std::memory_order_relaxed) || !waiting.exchange(false))
+        return;
+
+    ++signal;
+    signal.wakeOne();
+}
+
+template <typename T>
+void LFQueue<T>::_destroy()
+{
+    for (int32_t i = _readPos; i != _writePos; i = (i + 1) % _size)
+        _get(i)->~T();
+}
+
 template <typename T>
 void LFQueue<T>::clear()
 {
     LB_TS_SCOPED(_reader);
+    _destroy();
     _readPos = 0;
     _writePos = 0;
+    _signal(_popped, _writerWaiting);
 }
 
 template <typename T>
@@ -31,7 +94,8 @@ void LFQueue<T>::resize(const int32_t size)
     LBASSERT(isEmpty());
     _readPos = 0;
     _writePos = 0;
-    _data.resize(size + 1);
+    _data.reset(new Storage[size + 1]);
+    _size = size + 1;
 }
 
 template <typename T>
@@ -41,11 +105,21 @@ bool LFQueue<T>::pop(T& result)
     if (_readPos == _writePos)
         return false;
 
-    result = _data[_readPos];
-    _readPos = (_readPos + 1) % _data.size();
+    T* element = _get(_readPos);
+    result = std::move(*element);
+    element->~T();
+    _readPos = (_readPos + 1) % _size;
+    _signal(_popped, _writerWaiting);
     return true;
 }
 
+template <typename T>
+bool LFQueue<T>::timedPop(const uint32_t timeout, T& result)
+{
+    return _wait(_pushed, _readerWaiting, timeout,
+                 [&] { return pop(result); });
+}
+
 template <typename T>
 bool LFQueue<T>::getFront(T& result)
 {
@@ -53,20 +127,84 @@ bool LFQueue<T>::getFront(T& result)
     if (_readPos == _writePos)
         return false;
 
-    result = _data[_readPos];
+    result = *_get(_readPos);
     return true;
 }
 
 template <typename T>
-bool LFQueue<T>::push(const T& element)
+template <typename... Args>
+bool LFQueue<T>::emplace(Args&&... args)
 {
     LB_TS_SCOPED(_writer);
-    int32_t nextPos = (_writePos + 1) % _data.size();
+    int32_t nextPos = (_writePos + 1) % _size;
     if (nextPos == _readPos)
         return false;
 
-    _data[_writePos] = element;
+    new (_get(_writePos)) T(std::forward<Args>(args)...);
     _writePos = nextPos;
+    _signal(_pushed, _readerWaiting);
     return true;
 }
+
+template <typename T>
+bool LFQueue<T>::timedPush(const uint32_t timeout, const T& element)
+{
+    return _wait(_popped, _writerWaiting, timeout,
+                 [&] { return emplace(element); });
+}
+
+template <typename T>
+bool LFQueue<T>::timedPush(const uint32_t timeout, T&& element)
+{
+    // emplace() does not touch element if the queue is full
+    return _wait(_popped, _writerWaiting, timeout,
+                 [&] { return emplace(std::move(element)); });
+}
+
+template <typename T>
+size_t LFQueue<T>::push(const T* elements, const size_t num)
+{
+    LB_TS_SCOPED(_writer);
+    const int32_t writePos = _writePos;
+    const int32_t readPos = _readPos;
+    const size_t free = (readPos - writePos - 1 + _size) % _size;
+    const size_t n = LB_MIN(num, free);
+    if (n == 0)
+        return 0;
+
+    // copy up to the end of the ring buffer, then wrap around
+    const size_t first = LB_MIN(n, size_t(_size - writePos));
+    std::uninitialized_copy(elements, elements + first, _get(writePos));
+    std::uninitialized_copy(elements + first, elements + n, _get(0));
+
+    _writePos = int32_t((writePos + n) % _size);
+    _signal(_pushed, _readerWaiting);
+    return n;
+}
+
+template <typename T>
+size_t LFQueue<T>::pop(T* result, const size_t maximum)
+{
+    LB_TS_SCOPED(_reader);
+    const int32_t readPos = _readPos;
+    const int32_t writePos = _writePos;
+    const size_t used = (writePos - readPos + _size) % _size;
+    const size_t n = LB_MIN(maximum, used);
+    if (n == 0)
+        return 0;
+
+    int32_t pos = readPos;
+    for (size_t i = 0; i < n; ++i)
+    {
+        T* element = _get(pos);
+        result[i] = std::move(*element);
+        element->~T();
+        if (++pos == _size)
+            pos = 0;
+    }
+
+    _readPos = pos;
+    _signal(_popped, _writerWaiting);
+    return n;
+}
 }
@@ -0,0 +1,109 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_MPMCQUEUE_H
+#define LUNCHBOX_MPMCQUEUE_H
+
+#include <lunchbox/compiler.h> // LB_CACHELINE_SIZE
+#include <lunchbox/debug.h>    // used in inline method
+
+#include <atomic>
+#include <boost/noncopyable.hpp>
+#include <memory>
+
+namespace lunchbox
+{
+/**
+ * A thread-safe, lock-free, bounded queue with non-blocking access.
+ *
+ * Any number of threads may push and pop concurrently. Each slot of the ring
+ * buffer carries a sequence number which tells producers and consumers if the
+ * slot is ready for them, so that both sides only contend on their own
+ * position counter.
+ *
+ * Current implementation constraints:
+ * * Fixed maximum size, rounded up to a power of two (writes may fail)
+ * * Not copyable
+ *
+ * Example: @include tests/mpmcQueue.cpp
+ */
+template <typename T>
+class MPMCQueue : public boost::noncopyable
+{
+public:
+    /**
+     * Construct a new queue.
+     *
+     * @param size the minimum capacity of the queue.
+     * @version 1.18
+     */
+    explicit MPMCQueue(const size_t size);
+
+    /** Destruct this queue. @version 1.18 */
+    ~MPMCQueue() {}
+    /**
+     * @return true if the queue is empty, false otherwise. The result is only
+     *         a snapshot if other threads use the queue concurrently.
+     * @version 1.18
+     */
+    bool isEmpty() const;
+
+    /**
+     * Retrieve and pop the front element from the queue.
+     *
+     * @param result the front value or unmodified
+     * @return true if an element was placed in result, false if the queue
+     *         is empty.
+     * @version 1.18
+     */
+    bool pop(T& result);
+
+    /**
+     * Push a new element to the back of the queue.
+     *
+     * @param element the element to add.
+     * @return true if the element was placed, false if the queue is full
+     * @version 1.18
+     */
+    bool push(const T& element);
+
+    /**
+     * @return the maximum number of elements held by the queue.
+     * @version 1.18
+     */
+    size_t getCapacity() const { return _mask + 1; }
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    char _pad0[LB_CACHELINE_SIZE];
+    std::atomic<size_t> _writePos;
+    char _pad1[LB_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _readPos;
+    char _pad2[LB_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+};
+}
+
+#include "mpmcQueue.ipp" // template implementation
+
+#endif // LUNCHBOX_MPMCQUEUE_H
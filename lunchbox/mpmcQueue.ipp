@@ -0,0 +1,101 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+namespace lunchbox
+{
+// A cell at index i is free for the writer of position p if its sequence is p,
+// and holds the value for the reader of position p if its sequence is p + 1.
+// After a read, the sequence is advanced to p + capacity for the next lap.
+
+template <typename T>
+MPMCQueue<T>::MPMCQueue(const size_t size)
+    : _writePos(0)
+    , _readPos(0)
+    , _mask(0)
+{
+    size_t ringSize = 2;
+    while (ringSize < size)
+        ringSize <<= 1;
+
+    _cells.reset(new Cell[ringSize]);
+    _mask = ringSize - 1;
+    for (size_t i = 0; i < ringSize; ++i)
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool MPMCQueue<T>::isEmpty() const
+{
+    return _readPos.load(std::memory_order_acquire) >=
+           _writePos.load(std::memory_order_acquire);
+}
+
+template <typename T>
+bool MPMCQueue<T>::push(const T& element)
+{
+    size_t pos = _writePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = _cells[pos & _mask];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const std::ptrdiff_t diff = std::ptrdiff_t(sequence - pos);
+
+        if (diff == 0)
+        {
+            if (_writePos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed))
+            {
+                cell.data = element;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) // previous lap not yet consumed
+            return false;
+        else // another writer took this position
+            pos = _writePos.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool MPMCQueue<T>::pop(T& result)
+{
+    size_t pos = _readPos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = _cells[pos & _mask];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const std::ptrdiff_t diff = std::ptrdiff_t(sequence - (pos + 1));
+
+        if (diff == 0)
+        {
+            if (_readPos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+            {
+                result = cell.data;
+                cell.sequence.store(pos + _mask + 1,
+                                    std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) // not yet written
+            return false;
+        else // another reader took this position
+            pos = _readPos.load(std::memory_order_relaxed);
+    }
+}
+}
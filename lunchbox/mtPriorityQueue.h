@@ -0,0 +1,178 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_MTPRIORITYQUEUE_H
+#define LUNCHBOX_MTPRIORITYQUEUE_H
+
+#include <lunchbox/debug.h>
+
+#include <boost/noncopyable.hpp>
+#include <condition_variable>
+#include <deque>
+#include <limits.h>
+#include <mutex>
+#include <vector>
+
+namespace lunchbox
+{
+/**
+ * A thread-safe priority queue with a blocking read access.
+ *
+ * Elements are pushed with a priority level. Pop operations always return an
+ * element of the lowest non-empty level, and elements of the same level in
+ * the order they were pushed. Level 0 has the highest priority.
+ *
+ * The waiting semantics and the maximum size follow MTQueue: the maximum size
+ * applies to the sum of all levels, and pushing blocks while it is reached.
+ *
+ * Example: @include tests/mtPriorityQueue.cpp
+ */
+template <typename T, size_t S = ULONG_MAX>
+class MTPriorityQueue : public boost::noncopyable
+{
+public:
+    class Group;
+    typedef T value_type;
+
+    /**
+     * Construct a new queue.
+     *
+     * @param levels the number of priority levels.
+     * @param maxSize the maximum number of elements in all levels.
+     * @version 1.18
+     */
+    explicit MTPriorityQueue(const size_t levels, const size_t maxSize = S);
+
+    /** Destruct this queue. @version 1.18 */
+    ~MTPriorityQueue() {}
+    /** @return the number of priority levels. @version 1.18 */
+    size_t getLevels() const { return _queues.size(); }
+    /** @return true if the queue is empty, false otherwise. @version 1.18 */
+    bool isEmpty() const { return _size == 0; }
+    /** @return the number of items currently in the queue. @version 1.18 */
+    size_t getSize() const { return _size; }
+    /**
+     * Set the new maximum size of the queue.
+     *
+     * If the new maximum size is less the current size of the queue, this
+     * call will block until the queue reaches the new maximum size.
+     *
+     * @version 1.18
+     */
+    void setMaxSize(const size_t maxSize);
+
+    /** @return the current maximum size of the queue. @version 1.18 */
+    size_t getMaxSize() const { return _maxSize; }
+    /** Reset (empty) the queue. @version 1.18 */
+    void clear();
+
+    /**
+     * Retrieve and pop the most urgent element from the queue, may block.
+     * @version 1.18
+     */
+    T pop();
+
+    /**
+     * Retrieve and pop the most urgent element from the queue.
+     *
+     * @param timeout the timeout
+     * @param element the element returned
+     * @return true if an element was popped
+     * @version 1.18
+     */
+    bool timedPop(const unsigned timeout, T& element);
+
+    /**
+     * Retrieve a number of items in priority order from the queue.
+     *
+     * Between minimum and maximum number of items are returned in a vector. If
+     * the queue has less than minimum number of elements on timeout, the result
+     * vector is empty. The method returns as soon as there are at least minimum
+     * elements available, i.e., it does not wait for the maximum to be reached.
+     *
+     * @param timeout the timeout to wait for the minimum number of elements
+     * @param minimum the minimum number of items to retrieve
+     * @param maximum the maximum number of items to retrieve
+     * @return an empty vector on timeout, otherwise the result vector
+     *         containing between minimum and maximum elements.
+     * @version 1.18
+     */
+    std::vector<T> timedPopRange(const unsigned timeout,
+                                 const size_t minimum = 1,
+                                 const size_t maximum = S);
+
+    /**
+     * Retrieve and pop the most urgent element if the queue is not empty.
+     *
+     * @param result the front value or unmodified.
+     * @return true if an element was placed in result, false if the queue
+     *         is empty.
+     * @version 1.18
+     */
+    bool tryPop(T& result);
+
+    /**
+     * Retrieve the most urgent element, or abort if the barrier is reached
+     *
+     * @param result the result element, unmodified on false return value.
+     * @param barrier the group's barrier handle.
+     * @return true if an element was retrieved, false if the barrier height
+     *         was reached.
+     * @sa MTQueue::popBarrier()
+     * @version 1.18
+     */
+    bool popBarrier(T& result, Group& barrier);
+
+    /** Push a new element with the given level. @version 1.18 */
+    void push(const T& element, const size_t level);
+
+    /** Move a new element with the given level. @version 1.18 */
+    void push(T&& element, const size_t level);
+
+private:
+    std::vector<std::deque<T> > _queues; // one per level
+    size_t _size;
+    mutable std::mutex _mutex;
+    std::condition_variable _readCondition;  // data available
+    std::condition_variable _writeCondition; // space available
+    size_t _maxSize;
+    size_t _readWaiters;
+    size_t _writeWaiters;
+
+    T _popFront();
+    template <typename P>
+    bool _waitRead(std::unique_lock<std::mutex>& lock, const unsigned timeout,
+                   const P& predicate);
+    template <typename P>
+    void _waitWrite(std::unique_lock<std::mutex>& lock, const P& predicate);
+
+    void _notifyReaders()
+    {
+        if (_readWaiters > 0)
+            _readCondition.notify_all();
+    }
+    void _notifyWriters()
+    {
+        if (_writeWaiters > 0)
+            _writeCondition.notify_all();
+    }
+};
+}
+
+#include "mtPriorityQueue.ipp" // template implementation
+
+#endif // LUNCHBOX_MTPRIORITYQUEUE_H
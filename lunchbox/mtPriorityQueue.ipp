@@ -0,0 +1,224 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+namespace lunchbox
+{
+template <typename T, size_t S>
+MTPriorityQueue<T, S>::MTPriorityQueue(const size_t levels,
+                                       const size_t maxSize)
+    : _queues(levels)
+    , _size(0)
+    , _maxSize(maxSize)
+    , _readWaiters(0)
+    , _writeWaiters(0)
+{
+    LBASSERT(levels > 0);
+}
+
+template <typename T, size_t S>
+template <typename P>
+bool MTPriorityQueue<T, S>::_waitRead(std::unique_lock<std::mutex>& lock,
+                                      const unsigned timeout,
+                                      const P& predicate)
+{
+    if (predicate())
+        return true;
+
+    ++_readWaiters;
+    bool result = true;
+    if (timeout == LB_TIMEOUT_INDEFINITE)
+        _readCondition.wait(lock, predicate);
+    else
+        result =
+            _readCondition.wait_for(lock, std::chrono::milliseconds(timeout),
+                                    predicate);
+    --_readWaiters;
+    return result;
+}
+
+template <typename T, size_t S>
+template <typename P>
+void MTPriorityQueue<T, S>::_waitWrite(std::unique_lock<std::mutex>& lock,
+                                       const P& predicate)
+{
+    if (predicate())
+        return;
+
+    ++_writeWaiters;
+    _writeCondition.wait(lock, predicate);
+    --_writeWaiters;
+}
+
+template <typename T, size_t S>
+T MTPriorityQueue<T, S>::_popFront()
+{
+    LBASSERT(_size > 0);
+    size_t level = 0;
+    while (_queues[level].empty())
+        ++level;
+
+    std::deque<T>& queue = _queues[level];
+    T element = std::move(queue.front());
+    queue.pop_front();
+    --_size;
+    return element;
+}
+
+template <typename T, size_t S>
+void MTPriorityQueue<T, S>::setMaxSize(const size_t maxSize)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitWrite(lock, [&] { return _size <= maxSize; });
+
+    _maxSize = maxSize;
+    _notifyWriters();
+}
+
+template <typename T, size_t S>
+void MTPriorityQueue<T, S>::clear()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (std::deque<T>& queue : _queues)
+        queue.clear();
+    _size = 0;
+    _notifyWriters();
+}
+
+template <typename T, size_t S>
+T MTPriorityQueue<T, S>::pop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitRead(lock, LB_TIMEOUT_INDEFINITE, [&] { return _size > 0; });
+
+    T element = _popFront();
+    _notifyWriters();
+    return element;
+}
+
+template <typename T, size_t S>
+bool MTPriorityQueue<T, S>::timedPop(const unsigned timeout, T& element)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_waitRead(lock, timeout, [&] { return _size > 0; }))
+        return false;
+
+    element = _popFront();
+    _notifyWriters();
+    return true;
+}
+
+template <typename T, size_t S>
+std::vector<T> MTPriorityQueue<T, S>::timedPopRange(const unsigned timeout,
+                                                    const size_t minimum,
+                                                    const size_t maximum)
+{
+    std::vector<T> result;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_waitRead(lock, timeout, [&] { return _size >= minimum; }))
+        return result;
+
+    const size_t size = LB_MIN(maximum, _size);
+    result.reserve(size);
+    while (result.size() < size)
+        result.push_back(_popFront());
+
+    _notifyWriters();
+    return result;
+}
+
+template <typename T, size_t S>
+bool MTPriorityQueue<T, S>::tryPop(T& result)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_size == 0)
+        return false;
+
+    result = _popFront();
+    _notifyWriters();
+    return true;
+}
+
+/** Group descriptor for popBarrier(). @version 1.18 */
+template <typename T, size_t S>
+class MTPriorityQueue<T, S>::Group
+{
+    friend class MTPriorityQueue<T, S>;
+    size_t height_;
+    size_t waiting_;
+
+public:
+    /**
+     * Construct a new group of the given size. Can only be used once.
+     * @version 1.18
+     */
+    explicit Group(const size_t height)
+        : height_(height)
+        , waiting_(0)
+    {
+    }
+
+    /** Update the height. @version 1.18  */
+    void setHeight(const size_t height) { height_ = height; }
+};
+
+template <typename T, size_t S>
+bool MTPriorityQueue<T, S>::popBarrier(T& element, Group& barrier)
+{
+    LBASSERT(barrier.height_ > 0)
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    ++barrier.waiting_;
+    _waitRead(lock, LB_TIMEOUT_INDEFINITE, [&] {
+        return _size > 0 || barrier.waiting_ >= barrier.height_;
+    });
+
+    if (_size == 0)
+    {
+        LBASSERT(barrier.waiting_ == barrier.height_);
+        _notifyReaders(); // release the other group members
+        return false;
+    }
+
+    element = _popFront();
+    --barrier.waiting_;
+    _notifyWriters();
+    return true;
+}
+
+template <typename T, size_t S>
+void MTPriorityQueue<T, S>::push(const T& element, const size_t level)
+{
+    LBASSERT(level < _queues.size());
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitWrite(lock, [&] { return _size < _maxSize; });
+    _queues[level].push_back(element);
+    ++_size;
+    _notifyReaders();
+}
+
+template <typename T, size_t S>
+void MTPriorityQueue<T, S>::push(T&& element, const size_t level)
+{
+    LBASSERT(level < _queues.size());
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitWrite(lock, [&] { return _size < _maxSize; });
+    _queues[level].push_back(std::move(element));
+    ++_size;
+    _notifyReaders();
+}
+}
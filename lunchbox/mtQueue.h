@@ -20,13 +20,17 @@
 #define LUNCHBOX_MTQUEUE_H
 
 #include <lunchbox/debug.h>
+#include <lunchbox/queueSelector.h>
 
 #include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <iterator>
 #include <limits.h>
 #include <mutex>
 #include <queue>
 #include <string.h>
+#include <vector>
 
 namespace lunchbox
 {
@@ -39,6 +43,13 @@ namespace lunchbox
  * capacity of the Queue<T>.  When the capacity is reached, pushing new values
  * blocks until items have been consumed.
  *
+ * Threads waiting for data and threads waiting for free space sleep on
+ * separate condition variables, which are only signalled when a thread is
+ * actually sleeping. An uncontended push or pop therefore only costs a
+ * user-space lock and unlock of the internal mutex.
+ *
+ * Use a QueueSelector to wait on multiple queues from a single thread.
+ *
  * Example: @include tests/mtQueue.cpp
  */
 template <typename T, size_t S = ULONG_MAX>
@@ -53,16 +64,39 @@ public:
     /** Construct a new queue. @version 1.0 */
     explicit MTQueue(const size_t maxSize = S)
         : _maxSize(maxSize)
+        , _readWaiters(0)
+        , _writeWaiters(0)
     {
     }
 
     /** Construct a copy of a queue. @version 1.0 */
-    MTQueue(const MTQueue<T, S>& from) { *this = from; }
+    MTQueue(const MTQueue<T, S>& from)
+        : _readWaiters(0)
+        , _writeWaiters(0)
+    {
+        *this = from;
+    }
+    /** Move-construct a queue. Not thread-safe for from. @version 1.18 */
+    MTQueue(MTQueue<T, S>&& from)
+        : _queue(std::move(from._queue))
+        , _maxSize(from._maxSize)
+        , _readWaiters(0)
+        , _writeWaiters(0)
+    {
+    }
+
     /** Destruct this Queue. @version 1.0 */
-    ~MTQueue() {}
+    ~MTQueue()
+    {
+        LBASSERTINFO(_selectors.empty(),
+                     "Queue destroyed while used by a QueueSelector");
+    }
     /** Assign the values of another queue. @version 1.0 */
     MTQueue<T, S>& operator=(const MTQueue<T, S>& from);
 
+    /** Move the values of another queue into this queue. @version 1.18 */
+    MTQueue<T, S>& operator=(MTQueue<T, S>&& from);
+
     /**
      * Retrieve the requested element from the queue, may block.
      * @version 1.3.2
@@ -98,6 +132,9 @@ public:
 
     /**
      * Retrieve and pop the front element from the queue, may block.
+     *
+     * The element is moved out of the queue by this and all other pop
+     * methods.
      * @version 1.0
      */
     T pop();
@@ -120,10 +157,10 @@ public:
      * vector is empty. The method returns as soon as there are at least minimum
      * elements available, i.e., it does not wait for the maximum to be reached.
      *
-     * Note that this method might block up to 'minimum * timeout' milliseconds,
-     * that is, the timeout defines the time to wait for an update on the queue.
+     * The timeout is a single deadline for the whole call, independent of the
+     * number of updates received while waiting for the minimum.
      *
-     * @param timeout the timeout to wait for an update
+     * @param timeout the timeout to wait for the minimum number of elements
      * @param minimum the minimum number of items to retrieve
      * @param maximum the maximum number of items to retrieve
      * @return an empty vector on timeout, otherwise the result vector
@@ -134,6 +171,40 @@ public:
                                  const size_t minimum = 1,
                                  const size_t maximum = S);
 
+    /**
+     * Retrieve a number of items from the front of the queue into a vector.
+     *
+     * Same semantics as timedPopRange() above, but the elements are appended
+     * to the given vector. Clearing and reusing the same vector across calls
+     * avoids a memory allocation per call once its capacity is sufficient.
+     *
+     * @param timeout the timeout to wait for the minimum number of elements
+     * @param result the vector to append the retrieved elements to
+     * @param minimum the minimum number of items to retrieve
+     * @param maximum the maximum number of items to retrieve
+     * @return the number of elements appended, zero on timeout.
+     * @version 1.18
+     */
+    size_t timedPopRange(const unsigned timeout, std::vector<T>& result,
+                         const size_t minimum = 1, const size_t maximum = S);
+
+    /**
+     * Retrieve a number of items from the front of the queue into a buffer.
+     *
+     * Same semantics as timedPopRange() above, but the elements are moved into
+     * the first elements of the given buffer, which has to hold at least
+     * maximum elements.
+     *
+     * @param timeout the timeout to wait for the minimum number of elements
+     * @param result the buffer receiving the retrieved elements
+     * @param minimum the minimum number of items to retrieve
+     * @param maximum the maximum number of items to retrieve
+     * @return the number of elements retrieved, zero on timeout.
+     * @version 1.18
+     */
+    size_t timedPopRange(const unsigned timeout, T* result,
+                         const size_t minimum, const size_t maximum);
+
     /**
      * Retrieve and pop the front element from the queue if it is not empty.
      *
@@ -157,6 +228,19 @@ public:
      */
     void tryPop(const size_t num, std::vector<T>& result);
 
+    /**
+     * Try to retrieve a number of items from the front of the queue.
+     *
+     * Between zero and the given number of items are moved into the first
+     * elements of the given buffer, which has to hold at least num elements.
+     *
+     * @param num the maximum number of items to retrieve
+     * @param result the buffer receiving the retrieved elements
+     * @return the number of elements retrieved.
+     * @version 1.18
+     */
+    size_t tryPop(const size_t num, T* result);
+
     /**
      * Retrieve the front element, or abort if the barrier is reached
      *
@@ -191,9 +275,22 @@ public:
     /** Push a new element to the back of the queue. @version 1.0 */
     void push(const T& element);
 
+    /** Move a new element to the back of the queue. @version 1.18 */
+    void push(T&& element);
+
+    /**
+     * Construct a new element in place at the back of the queue.
+     * @version 1.18
+     */
+    template <typename... Args>
+    void emplace(Args&&... args);
+
     /** Push a vector of elements to the back of the queue. @version 1.0 */
     void push(const std::vector<T>& elements);
 
+    /** Move a vector of elements to the back of the queue. @version 1.18 */
+    void push(std::vector<T>&& elements);
+
     /** Push a new element to the front of the queue. @version 1.0 */
     void pushFront(const T& element);
 
@@ -203,17 +300,45 @@ public:
     /** @name STL compatibility. @version 1.7.1 */
     //@{
     void push_back(const T& element) { push(element); }
+    void push_back(T&& element) { push(std::move(element)); }
     bool empty() const { return isEmpty(); }
     //@}
 
 private:
-    MTQueue(MTQueue<T, S>&&) = delete;
-    MTQueue<T, S>& operator=(MTQueue<T, S>&&) = delete;
+    friend class QueueSelector;
 
     std::deque<T> _queue;
     mutable std::mutex _mutex;
-    mutable std::condition_variable _condition;
+    mutable std::condition_variable _readCondition;  // data available
+    mutable std::condition_variable _writeCondition; // space available
     size_t _maxSize;
+    mutable size_t _readWaiters;
+    size_t _writeWaiters;
+    std::vector<QueueSelector*> _selectors;
+
+    template <typename P>
+    void _waitRead(std::unique_lock<std::mutex>& lock,
+                   const P& predicate) const;
+    template <typename P>
+    bool _waitRead(std::unique_lock<std::mutex>& lock, const unsigned timeout,
+                   const P& predicate);
+    template <typename O>
+    size_t _popRange(O result, const size_t maximum);
+    template <typename P>
+    void _waitWrite(std::unique_lock<std::mutex>& lock, const P& predicate);
+
+    void _notifyReaders()
+    {
+        if (_readWaiters > 0)
+            _readCondition.notify_all();
+        for (QueueSelector* selector : _selectors)
+            selector->_signal();
+    }
+    void _notifyWriters()
+    {
+        if (_writeWaiters > 0)
+            _writeCondition.notify_all();
+    }
 };
 }
 
@@ -32,15 +32,80 @@ MTQueue<T, S>& MTQueue<T, S>::operator=(const MTQueue<T, S>& from)
     std::unique_lock<std::mutex> lock(_mutex);
     _maxSize = maxSize;
     _queue.swap(copy);
-    _condition.notify_all();
+    _notifyReaders();
+    _notifyWriters();
     return *this;
 }
 
+template <typename T, size_t S>
+MTQueue<T, S>& MTQueue<T, S>::operator=(MTQueue<T, S>&& from)
+{
+    if (this == &from)
+        return *this;
+
+    std::unique_lock<std::mutex> fromLock(from._mutex);
+    std::deque<T> moved(std::move(from._queue));
+    from._queue.clear();
+    const size_t maxSize = from._maxSize;
+    from._notifyWriters();
+    fromLock.unlock();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _maxSize = maxSize;
+    _queue.swap(moved);
+    _notifyReaders();
+    _notifyWriters();
+    return *this;
+}
+
+template <typename T, size_t S>
+template <typename P>
+void MTQueue<T, S>::_waitRead(std::unique_lock<std::mutex>& lock,
+                              const P& predicate) const
+{
+    if (predicate())
+        return;
+
+    ++_readWaiters;
+    _readCondition.wait(lock, predicate);
+    --_readWaiters;
+}
+
+template <typename T, size_t S>
+template <typename P>
+bool MTQueue<T, S>::_waitRead(std::unique_lock<std::mutex>& lock,
+                              const unsigned timeout, const P& predicate)
+{
+    if (predicate())
+        return true;
+
+    // One absolute deadline for all wakeups until the predicate is met
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    ++_readWaiters;
+    const bool result = _readCondition.wait_until(lock, deadline, predicate);
+    --_readWaiters;
+    return result;
+}
+
+template <typename T, size_t S>
+template <typename P>
+void MTQueue<T, S>::_waitWrite(std::unique_lock<std::mutex>& lock,
+                               const P& predicate)
+{
+    if (predicate())
+        return;
+
+    ++_writeWaiters;
+    _writeCondition.wait(lock, predicate);
+    --_writeWaiters;
+}
+
 template <typename T, size_t S>
 const T& MTQueue<T, S>::operator[](const size_t index) const
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return _queue.size() > index; });
+    _waitRead(lock, [&] { return _queue.size() > index; });
 
     return _queue[index];
 }
@@ -49,10 +114,10 @@ template <typename T, size_t S>
 void MTQueue<T, S>::setMaxSize(const size_t maxSize)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return _queue.size() <= maxSize; });
+    _waitWrite(lock, [&] { return _queue.size() <= maxSize; });
 
     _maxSize = maxSize;
-    _condition.notify_all();
+    _notifyWriters();
 }
 
 template <typename T, size_t S>
@@ -60,7 +125,7 @@ size_t MTQueue<T, S>::waitSize(const size_t minSize) const
 {
     LBASSERT(minSize <= _maxSize);
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return _queue.size() >= minSize; });
+    _waitRead(lock, [&] { return _queue.size() >= minSize; });
     return _queue.size();
 }
 
@@ -69,18 +134,18 @@ void MTQueue<T, S>::clear()
 {
     std::unique_lock<std::mutex> lock(_mutex);
     _queue.clear();
-    _condition.notify_all();
+    _notifyWriters();
 }
 
 template <typename T, size_t S>
 T MTQueue<T, S>::pop()
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return !_queue.empty(); });
+    _waitRead(lock, [&] { return !_queue.empty(); });
 
-    T element = _queue.front();
+    T element = std::move(_queue.front());
     _queue.pop_front();
-    _condition.notify_all();
+    _notifyWriters();
     return element;
 }
 
@@ -88,38 +153,62 @@ template <typename T, size_t S>
 bool MTQueue<T, S>::timedPop(const unsigned timeout, T& element)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait_for(lock, std::chrono::milliseconds(timeout),
-                        [&] { return !_queue.empty(); });
-    if (_queue.empty())
+    if (!_waitRead(lock, timeout, [&] { return !_queue.empty(); }))
         return false;
 
-    element = _queue.front();
+    element = std::move(_queue.front());
     _queue.pop_front();
-    _condition.notify_all();
+    _notifyWriters();
     return true;
 }
 
+template <typename T, size_t S>
+template <typename O>
+size_t MTQueue<T, S>::_popRange(O result, const size_t maximum)
+{
+    const size_t size = LB_MIN(maximum, _queue.size());
+    if (size == 0)
+        return 0;
+
+    const typename std::deque<T>::iterator end = _queue.begin() + size;
+    std::move(_queue.begin(), end, result);
+    _queue.erase(_queue.begin(), end);
+    _notifyWriters();
+    return size;
+}
+
 template <typename T, size_t S>
 std::vector<T> MTQueue<T, S>::timedPopRange(const unsigned timeout,
                                             const size_t minimum,
                                             const size_t maximum)
 {
     std::vector<T> result;
+    timedPopRange(timeout, result, minimum, maximum);
+    return result;
+}
 
+template <typename T, size_t S>
+size_t MTQueue<T, S>::timedPopRange(const unsigned timeout,
+                                    std::vector<T>& result,
+                                    const size_t minimum, const size_t maximum)
+{
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait_for(lock, std::chrono::milliseconds(timeout),
-                        [&] { return _queue.size() >= minimum; });
-    if (_queue.size() < minimum)
-        return result;
+    if (!_waitRead(lock, timeout, [&] { return _queue.size() >= minimum; }))
+        return 0;
 
-    const size_t size = LB_MIN(maximum, _queue.size());
+    result.reserve(result.size() + LB_MIN(maximum, _queue.size()));
+    return _popRange(std::back_inserter(result), maximum);
+}
 
-    result.reserve(size);
-    result.insert(result.end(), _queue.begin(), _queue.begin() + size);
-    _queue.erase(_queue.begin(), _queue.begin() + size);
+template <typename T, size_t S>
+size_t MTQueue<T, S>::timedPopRange(const unsigned timeout, T* result,
+                                    const size_t minimum, const size_t maximum)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_waitRead(lock, timeout, [&] { return _queue.size() >= minimum; }))
+        return 0;
 
-    _condition.notify_all();
-    return result;
+    return _popRange(result, maximum);
 }
 
 template <typename T, size_t S>
@@ -129,9 +218,9 @@ bool MTQueue<T, S>::tryPop(T& result)
     if (_queue.empty())
         return false;
 
-    result = _queue.front();
+    result = std::move(_queue.front());
     _queue.pop_front();
-    _condition.notify_all();
+    _notifyWriters();
     return true;
 }
 
@@ -139,17 +228,15 @@ template <typename T, size_t S>
 void MTQueue<T, S>::tryPop(const size_t num, std::vector<T>& result)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    const size_t size = LB_MIN(num, _queue.size());
-    if (size > 0)
-    {
-        result.reserve(result.size() + size);
-        for (size_t i = 0; i < size; ++i)
-        {
-            result.push_back(_queue.front());
-            _queue.pop_front();
-        }
-        _condition.notify_all();
-    }
+    result.reserve(result.size() + LB_MIN(num, _queue.size()));
+    _popRange(std::back_inserter(result), num);
+}
+
+template <typename T, size_t S>
+size_t MTQueue<T, S>::tryPop(const size_t num, T* result)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _popRange(result, num);
 }
 
 /** Group descriptor for popBarrier(). @version 1.7.1 */
@@ -182,21 +269,21 @@ bool MTQueue<T, S>::popBarrier(T& element, Group& barrier)
 
     std::unique_lock<std::mutex> lock(_mutex);
     ++barrier.waiting_;
-    _condition.wait(lock, [&] {
+    _waitRead(lock, [&] {
         return !_queue.empty() || barrier.waiting_ >= barrier.height_;
     });
 
     if (_queue.empty())
     {
         LBASSERT(barrier.waiting_ == barrier.height_);
-        _condition.notify_all();
+        _notifyReaders(); // release the other group members
         return false;
     }
 
-    element = _queue.front();
+    element = std::move(_queue.front());
     _queue.pop_front();
     --barrier.waiting_;
-    _condition.notify_all();
+    _notifyWriters();
     return true;
 }
 
@@ -228,9 +315,28 @@ template <typename T, size_t S>
 void MTQueue<T, S>::push(const T& element)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return _queue.size() < _maxSize; });
+    _waitWrite(lock, [&] { return _queue.size() < _maxSize; });
     _queue.push_back(element);
-    _condition.notify_all();
+    _notifyReaders();
+}
+
+template <typename T, size_t S>
+void MTQueue<T, S>::push(T&& element)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitWrite(lock, [&] { return _queue.size() < _maxSize; });
+    _queue.push_back(std::move(element));
+    _notifyReaders();
+}
+
+template <typename T, size_t S>
+template <typename... Args>
+void MTQueue<T, S>::emplace(Args&&... args)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waitWrite(lock, [&] { return _queue.size() < _maxSize; });
+    _queue.emplace_back(std::forward<Args>(args)...);
+    _notifyReaders();
 }
 
 template <typename T, size_t S>
@@ -238,22 +344,34 @@ void MTQueue<T, S>::push(const std::vector<T>& elements)
 {
     std::unique_lock<std::mutex> lock(_mutex);
     LBASSERT(elements.size() <= _maxSize);
-    _condition.wait(lock, [&] {
+    _waitWrite(lock, [&] {
         return (_maxSize - _queue.size()) >= elements.size();
     });
-    ;
     _queue.insert(_queue.end(), elements.begin(), elements.end());
-    _condition.notify_all();
+    _notifyReaders();
+}
+
+template <typename T, size_t S>
+void MTQueue<T, S>::push(std::vector<T>&& elements)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    LBASSERT(elements.size() <= _maxSize);
+    _waitWrite(lock, [&] {
+        return (_maxSize - _queue.size()) >= elements.size();
+    });
+    _queue.insert(_queue.end(), std::make_move_iterator(elements.begin()),
+                  std::make_move_iterator(elements.end()));
+    elements.clear();
+    _notifyReaders();
 }
 
 template <typename T, size_t S>
 void MTQueue<T, S>::pushFront(const T& element)
 {
     std::unique_lock<std::mutex> lock(_mutex);
-    _condition.wait(lock, [&] { return _queue.size() < _maxSize; });
-    ;
+    _waitWrite(lock, [&] { return _queue.size() < _maxSize; });
     _queue.push_front(element);
-    _condition.notify_all();
+    _notifyReaders();
 }
 
 template <typename T, size_t S>
@@ -261,11 +379,10 @@ void MTQueue<T, S>::pushFront(const std::vector<T>& elements)
 {
     std::unique_lock<std::mutex> lock(_mutex);
     LBASSERT(elements.size() <= _maxSize);
-    _condition.wait(lock, [&] {
+    _waitWrite(lock, [&] {
         return (_maxSize - _queue.size()) >= elements.size();
     });
-    ;
     _queue.insert(_queue.begin(), elements.begin(), elements.end());
-    _condition.notify_all();
+    _notifyReaders();
 }
 }
@@ -0,0 +1,105 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_PARALLEL_H
+#define LUNCHBOX_PARALLEL_H
+
+#include <lunchbox/futex.h>
+#include <lunchbox/threadPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+/**
+ * @file lunchbox/parallel.h
+ *
+ * Data-parallel loops executed on a ThreadPool.
+ *
+ * The range is split into chunks which are claimed dynamically by the calling
+ * thread and up to ThreadPool::getSize() helper tasks. Chunks start large and
+ * shrink towards the grain size as the range is consumed, which balances
+ * uneven work with few claims. The calling thread always participates and
+ * only waits for chunks already being executed by helpers. The functions may
+ * therefore be called from within a task of the same pool without deadlock,
+ * even on a pool with a single thread.
+ *
+ * The first exception thrown by the loop body is rethrown to the caller after
+ * all chunks have completed.
+ *
+ * Example: @include tests/parallel.cpp
+ */
+
+namespace lunchbox
+{
+/**
+ * Call fn( i ) for each i in [begin, end) in parallel.
+ *
+ * @param begin the first index or random access iterator.
+ * @param end the end index or iterator.
+ * @param grain the minimum number of elements processed by one chunk.
+ * @param fn the loop body.
+ * @param pool the thread pool providing the helper threads.
+ * @version 1.18
+ */
+template <typename I, typename F>
+void parallelFor(I begin, I end, size_t grain, const F& fn,
+                 ThreadPool& pool = ThreadPool::getInstance());
+
+/**
+ * Reduce map( i ) for each i in [begin, end) in parallel.
+ *
+ * The reduction has to be associative and commutative, since partial results
+ * are combined in completion order.
+ *
+ * @param begin the first index or random access iterator.
+ * @param end the end index or iterator.
+ * @param grain the minimum number of elements processed by one chunk.
+ * @param identity the identity element of the reduction.
+ * @param map the function producing a value for each element.
+ * @param reduce the function combining two values into one.
+ * @param pool the thread pool providing the helper threads.
+ * @return the reduction of all mapped values.
+ * @version 1.18
+ */
+template <typename I, typename T, typename M, typename R>
+T parallelReduce(I begin, I end, size_t grain, const T& identity,
+                 const M& map, const R& reduce,
+                 ThreadPool& pool = ThreadPool::getInstance());
+
+/**
+ * Assign fn( *it ) to the corresponding output for each element in parallel.
+ *
+ * @param first the begin of the random access input range.
+ * @param last the end of the random access input range.
+ * @param result the begin of the random access output range.
+ * @param grain the minimum number of elements processed by one chunk.
+ * @param fn the transformation.
+ * @param pool the thread pool providing the helper threads.
+ * @return the end of the output range.
+ * @version 1.18
+ */
+template <typename I, typename O, typename F>
+O parallelTransform(I first, I last, O result, size_t grain, const F& fn,
+                    ThreadPool& pool = ThreadPool::getInstance());
+}
+
+#include "parallel.ipp" // template implementation
+
+#endif // LUNCHBOX_PARALLEL_H
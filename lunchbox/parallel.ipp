@@ -0,0 +1,183 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+namespace lunchbox
+{
+namespace detail
+{
+/**
+ * Shared between the caller and its helper tasks. Helpers may outlive the
+ * call, but only access the chunk function after claiming a chunk, which is
+ * impossible once the caller returned.
+ */
+template <typename C>
+class ParallelLoop
+{
+public:
+    ParallelLoop(const size_t size, const size_t grain,
+                 const size_t participants, const C& chunk)
+        : _size(size)
+        , _grain(std::max(grain, size_t(1)))
+        , _participants(participants)
+        , _chunk(chunk)
+        , _next(0)
+        , _done(0)
+    {
+    }
+
+    /** Execute chunks until all are claimed. */
+    void run()
+    {
+        size_t begin = _next.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (begin >= _size)
+                return;
+
+            const size_t remaining = _size - begin;
+            const size_t num =
+                std::min(remaining,
+                         std::max(_grain, remaining / (2 * _participants)));
+            if (!_next.compare_exchange_weak(begin, begin + num))
+                continue;
+
+            try
+            {
+                _chunk(begin, begin + num);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_exception)
+                    _exception = std::current_exception();
+            }
+
+            if (_done.fetch_add(num) + num == _size)
+            {
+                _finished = 1;
+                _finished.wakeAll();
+            }
+            begin = _next.load(std::memory_order_relaxed);
+        }
+    }
+
+    /** Wait for all chunks and rethrow the first exception, if any. */
+    void wait()
+    {
+        while (_finished == 0)
+            _finished.wait(0);
+        if (_exception)
+            std::rethrow_exception(_exception);
+    }
+
+private:
+    const size_t _size;
+    const size_t _grain;
+    const size_t _participants;
+    const C& _chunk;
+
+    std::atomic<size_t> _next;
+    std::atomic<size_t> _done;
+    Futex _finished;
+    std::mutex _mutex;
+    std::exception_ptr _exception;
+};
+
+/** Call chunk( begin, end ) in parallel for sub-ranges of [0, size). */
+template <typename C>
+void parallelChunks(const size_t size, const size_t grain, const C& chunk,
+                    lunchbox::ThreadPool& pool)
+{
+    if (size == 0)
+        return;
+
+    const size_t minimum = std::max(grain, size_t(1));
+    const size_t chunks = (size + minimum - 1) / minimum;
+    const size_t helpers = std::min(pool.getSize(), chunks - 1);
+    if (helpers == 0)
+    {
+        chunk(0, size);
+        return;
+    }
+
+    typedef ParallelLoop<C> Loop;
+    std::shared_ptr<Loop> loop =
+        std::allocate_shared<Loop>(TaskAllocator<Loop>(), size, grain,
+                                   helpers + 1, chunk);
+    for (size_t i = 0; i < helpers; ++i)
+        pool.postDetached([loop] { loop->run(); });
+
+    loop->run();
+    loop->wait();
+}
+}
+
+template <typename I, typename F>
+void parallelFor(const I begin, const I end, const size_t grain, const F& fn,
+                 ThreadPool& pool)
+{
+    if (!(begin < end))
+        return;
+
+    detail::parallelChunks(size_t(end - begin), grain,
+                           [&](const size_t first, const size_t last) {
+                               for (size_t i = first; i < last; ++i)
+                                   fn(begin + i);
+                           },
+                           pool);
+}
+
+template <typename I, typename T, typename M, typename R>
+T parallelReduce(const I begin, const I end, const size_t grain,
+                 const T& identity, const M& map, const R& reduce,
+                 ThreadPool& pool)
+{
+    if (!(begin < end))
+        return identity;
+
+    T result = identity;
+    std::mutex mutex;
+    detail::parallelChunks(size_t(end - begin), grain,
+                           [&](const size_t first, const size_t last) {
+                               T partial = identity;
+                               for (size_t i = first; i < last; ++i)
+                                   partial = reduce(partial, map(begin + i));
+
+                               std::lock_guard<std::mutex> lock(mutex);
+                               result = reduce(result, partial);
+                           },
+                           pool);
+    return result;
+}
+
+template <typename I, typename O, typename F>
+O parallelTransform(const I first, const I last, const O result,
+                    const size_t grain, const F& fn, ThreadPool& pool)
+{
+    if (!(first < last))
+        return result;
+
+    const size_t size = last - first;
+    detail::parallelChunks(size, grain,
+                           [&](const size_t begin, const size_t end) {
+                               for (size_t i = begin; i < end; ++i)
+                                   result[i] = fn(first[i]);
+                           },
+                           pool);
+    return result + size;
+}
+}
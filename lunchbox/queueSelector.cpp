@@ -0,0 +1,86 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "queueSelector.h"
+
+#include "debug.h"
+
+#include <chrono>
+
+namespace lunchbox
+{
+QueueSelector::~QueueSelector()
+{
+    for (const Entry& entry : _queues)
+        entry.detach(entry.queue, this);
+}
+
+bool QueueSelector::_scan(size_t& index)
+{
+    const size_t size = _queues.size();
+    for (size_t i = 0; i < size; ++i)
+    {
+        const size_t candidate = (_next + i) % size;
+        const Entry& entry = _queues[candidate];
+        if (entry.hasData(entry.queue))
+        {
+            index = candidate;
+            _next = candidate + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t QueueSelector::wait()
+{
+    size_t index = 0;
+    LBCHECK(timedWait(LB_TIMEOUT_INDEFINITE, index));
+    return index;
+}
+
+bool QueueSelector::timedWait(const uint32_t timeout, size_t& index)
+{
+    LBASSERT(!_queues.empty());
+    const auto start = std::chrono::steady_clock::now();
+
+    for (;;)
+    {
+        const uint32_t epoch = _epoch.load();
+        if (_scan(index))
+            return true;
+
+        uint32_t remaining = LB_TIMEOUT_INDEFINITE;
+        if (timeout != LB_TIMEOUT_INDEFINITE)
+        {
+            const auto elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+            if (elapsed >= timeout)
+                return false;
+            remaining = timeout - uint32_t(elapsed);
+        }
+
+        // Publish sleeping before re-checking the epoch, pairs with _signal()
+        _sleeping.store(true);
+        if (_epoch.load() == epoch)
+            _epoch.wait(epoch, remaining);
+        _sleeping.store(false);
+    }
+}
+}
@@ -0,0 +1,160 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_QUEUESELECTOR_H
+#define LUNCHBOX_QUEUESELECTOR_H
+
+#include <lunchbox/api.h>
+#include <lunchbox/futex.h>
+
+#include <boost/noncopyable.hpp>
+#include <mutex>
+#include <vector>
+
+namespace lunchbox
+{
+template <typename T, size_t S>
+class MTQueue;
+
+/**
+ * Blocks a single thread until any of a set of MTQueue has data.
+ *
+ * The in-process equivalent of select or poll: queues are added once, and
+ * wait() returns the index of a non-empty queue, in the order the queues were
+ * added. Readiness is level-triggered, the caller pops from the reported queue
+ * itself. Successive calls scan the queues round-robin, starting after the
+ * last reported queue, so one busy queue can not starve the others.
+ *
+ * Pushing to a queue only bumps an atomic counter of each attached selector,
+ * the waiting thread is only woken if it is actually sleeping.
+ *
+ * Only one thread may call wait() or timedWait() at a time. Queues have to be
+ * added before waiting, and have to outlive the selector.
+ *
+ * Example: @include tests/queueSelector.cpp
+ */
+class QueueSelector : public boost::noncopyable
+{
+public:
+    /** Construct a new, empty selector. @version 1.18 */
+    QueueSelector()
+        : _epoch(0)
+        , _sleeping(false)
+        , _next(0)
+    {
+    }
+
+    /** Destruct this selector and detach it from all queues. @version 1.18 */
+    LUNCHBOX_API ~QueueSelector();
+
+    /**
+     * Add a queue to the set of selected queues.
+     *
+     * @param queue the queue to watch.
+     * @return the index reported by wait() when this queue has data.
+     * @version 1.18
+     */
+    template <typename T, size_t S>
+    size_t add(MTQueue<T, S>& queue);
+
+    /** @return the number of selected queues. @version 1.18 */
+    size_t getSize() const { return _queues.size(); }
+
+    /**
+     * Wait until any selected queue has data.
+     *
+     * @return the index of a non-empty queue.
+     * @version 1.18
+     */
+    LUNCHBOX_API size_t wait();
+
+    /**
+     * Wait until any selected queue has data, or the timeout expires.
+     *
+     * @param timeout the timeout in milliseconds.
+     * @param index set to the index of a non-empty queue, unmodified on
+     *              timeout.
+     * @return true if a queue has data, false on timeout.
+     * @version 1.18
+     */
+    LUNCHBOX_API bool timedWait(const uint32_t timeout, size_t& index);
+
+private:
+    template <typename T, size_t S>
+    friend class MTQueue;
+
+    // Type-erased queue, no allocation besides the vector
+    struct Entry
+    {
+        void* queue;
+        bool (*hasData)(void*);
+        void (*detach)(void*, QueueSelector*);
+    };
+
+    std::vector<Entry> _queues;
+    Futex _epoch; // incremented on each push to any queue
+    std::atomic<bool> _sleeping;
+    size_t _next; // round-robin start of the next scan
+
+    bool _scan(size_t& index);
+
+    /** Called by queues on push, with the queue mutex locked. */
+    void _signal()
+    {
+        ++_epoch;
+        if (_sleeping.load())
+            _epoch.wakeOne();
+    }
+
+    template <typename T, size_t S>
+    static bool _hasData(void* queue)
+    {
+        MTQueue<T, S>* mtQueue = static_cast<MTQueue<T, S>*>(queue);
+        std::unique_lock<std::mutex> lock(mtQueue->_mutex);
+        return !mtQueue->_queue.empty();
+    }
+
+    template <typename T, size_t S>
+    static void _detach(void* queue, QueueSelector* selector)
+    {
+        MTQueue<T, S>* mtQueue = static_cast<MTQueue<T, S>*>(queue);
+        std::unique_lock<std::mutex> lock(mtQueue->_mutex);
+        std::vector<QueueSelector*>& selectors = mtQueue->_selectors;
+        for (size_t i = 0; i < selectors.size(); ++i)
+        {
+            if (selectors[i] == selector)
+            {
+                selectors.erase(selectors.begin() + i);
+                return;
+            }
+        }
+    }
+};
+
+template <typename T, size_t S>
+size_t QueueSelector::add(MTQueue<T, S>& queue)
+{
+    const Entry entry = {&queue, &_hasData<T, S>, &_detach<T, S>};
+    _queues.push_back(entry);
+
+    std::unique_lock<std::mutex> lock(queue._mutex);
+    queue._selectors.push_back(this);
+    return _queues.size() - 1;
+}
+}
+
+#endif // LUNCHBOX_QUEUESELECTOR_H
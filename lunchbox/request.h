@@ -21,9 +21,16 @@
 #include <boost/mpl/if.hpp>
 #include <boost/type_traits/is_same.hpp>
 #include <lunchbox/future.h>
+#include <lunchbox/threadPool.h> // used inline
+
+#include <type_traits>
+#include <utility>
 
 namespace lunchbox
 {
+template <typename T, size_t S>
+class MTQueue;
+
 class UnregisteredRequest : public std::runtime_error
 {
 public:
@@ -35,6 +42,14 @@ public:
 
 /**
  * A Future implementation for a RequestHandler request.
+ *
+ * Besides void, void*, uint32_t, bool and uint128_t, T may be any default
+ * constructible and movable type, served with the typed
+ * RequestHandler::serveRequest(). Results which are not copyable are moved out
+ * on the first wait(), later calls return a moved-from value.
+ *
+ * Instead of waiting, a continuation may be attached using then(), which is
+ * executed by the thread serving the request.
  * @version 1.9.1
  */
 template <class T>
@@ -47,7 +62,8 @@ public:
     Request(RequestHandler& handler, const uint32_t request);
 
     /**
-     * Destruct and wait for completion of the request, unless relinquished.
+     * Destruct and wait for completion of the request, unless relinquished
+     * or expired.
      * @version 1.9.1
      */
     virtual ~Request();
@@ -63,6 +79,45 @@ public:
      * @version 1.13
      */
     void unregister();
+
+    /**
+     * Call the given function with the result once the request is served.
+     *
+     * The function is called by the thread serving the request, or by the
+     * calling thread if the request is already served, and should not block.
+     * The request is consumed by the continuation: it is not waited for at
+     * destruction, and wait() throws.
+     *
+     * @param callback called with the result, without arguments for void.
+     * @throw UnregisteredRequest if the request is unregistered or expired.
+     * @version 1.18
+     */
+    template <class F>
+    void then(F&& callback);
+
+    /**
+     * Call the given function with the result once the request is served, or
+     * the other one without arguments if the request expires first.
+     *
+     * @param callback called with the result, without arguments for void.
+     * @param expired called by the thread expiring the request.
+     * @throw UnregisteredRequest if the request is unregistered or expired.
+     * @sa then(F&&), RequestHandler::registerRequest(void*, uint32_t)
+     * @version 1.18
+     */
+    template <class F, class E>
+    void then(F&& callback, E&& expired);
+
+    /**
+     * Execute callback( result ) as a task on the given pool once served.
+     * @version 1.18
+     */
+    template <class F>
+    void then(ThreadPool& pool, F&& callback);
+
+    /** Push the result into the given queue once served. @version 1.18 */
+    template <size_t S>
+    void then(MTQueue<T, S>& queue);
 };
 } // namespace lunchbox
 
@@ -71,6 +126,109 @@ public:
 #include <lunchbox/requestHandler.h>
 namespace lunchbox
 {
+namespace detail
+{
+/** The default handler of an expired request with a continuation. */
+struct RequestExpired
+{
+    void operator()() {}
+};
+
+/**
+ * Retrieves the result of a served request and calls a function with it, or
+ * another function if the request expired.
+ */
+template <class T, class F, class E>
+struct RequestContinuation
+{
+    RequestContinuation(lunchbox::RequestHandler& owner,
+                        const uint32_t requestID, F&& function, E&& failure)
+        : handler(&owner)
+        , request(requestID)
+        , callback(std::move(function))
+        , expired(std::move(failure))
+    {
+    }
+
+    static void call(F& function, T& result) { function(std::move(result)); }
+    void operator()()
+    {
+        T result = T();
+        if (handler->waitRequest(request, result, 0))
+            call(callback, result);
+        else
+            expired();
+    }
+
+    lunchbox::RequestHandler* handler;
+    uint32_t request;
+    F callback;
+    E expired;
+};
+
+template <class F, class E>
+struct RequestContinuation<void, F, E>
+{
+    RequestContinuation(lunchbox::RequestHandler& owner,
+                        const uint32_t requestID, F&& function, E&& failure)
+        : handler(&owner)
+        , request(requestID)
+        , callback(std::move(function))
+        , expired(std::move(failure))
+    {
+    }
+
+    static void call(F& function, void*&) { function(); }
+    void operator()()
+    {
+        if (handler->waitRequest(request))
+            callback();
+        else
+            expired();
+    }
+
+    lunchbox::RequestHandler* handler;
+    uint32_t request;
+    F callback;
+    E expired;
+};
+
+/** Calls a function with the result of a request on a thread pool. */
+template <class T, class F>
+struct RequestPost
+{
+    struct Call
+    {
+        void operator()() { callback(std::move(result)); }
+        F callback;
+        T result;
+    };
+
+    void operator()(T&& result)
+    {
+        pool->postDetached(Call{std::move(callback), std::move(result)});
+    }
+
+    lunchbox::ThreadPool* pool;
+    F callback;
+};
+
+template <class F>
+struct RequestPost<void, F>
+{
+    void operator()() { pool->postDetached(std::move(callback)); }
+    lunchbox::ThreadPool* pool;
+    F callback;
+};
+
+template <class T, size_t S>
+struct RequestPush
+{
+    void operator()(T&& result) { queue->push(std::move(result)); }
+    MTQueue<T, S>* queue;
+};
+}
+
 template <class T>
 class Request<T>::Impl : public FutureImpl<T>
 {
@@ -80,7 +238,7 @@ class Request<T>::Impl : public FutureImpl<T>
 public:
     Impl(RequestHandler& handler, const uint32_t req)
         : request(req)
-        , result(0)
+        , result()
         , handler_(handler)
         , state_(UNRESOLVED)
     {
@@ -100,6 +258,33 @@ public:
 
     bool isUnresolved() const { return state_ == UNRESOLVED; }
 
+    template <class F, class E>
+    void then(F&& callback, E&& expired)
+    {
+        typedef typename std::decay<F>::type Function;
+        typedef typename std::decay<E>::type Expired;
+        typedef detail::RequestContinuation<T, Function, Expired> Continuation;
+        Function function(std::forward<F>(callback));
+        switch (state_)
+        {
+        case UNREGISTERED:
+            throw UnregisteredRequest();
+        case DONE:
+            state_ = UNREGISTERED;
+            Continuation::call(function, result);
+            return;
+        default: // UNRESOLVED
+            state_ = UNREGISTERED; // consumed by the continuation
+            if (!handler_.setContinuation(
+                    request, Continuation(handler_, request,
+                                          std::move(function),
+                                          Expired(std::forward<E>(expired)))))
+            {
+                throw UnregisteredRequest(); // expired
+            }
+        }
+    }
+
 protected:
     T wait(const uint32_t timeout) final
     {
@@ -110,7 +295,11 @@ protected:
         /* fall-thru */
         case UNRESOLVED:
             if (!handler_.waitRequest(request, result, timeout))
+            {
+                if (!handler_.isRequestPending(request))
+                    state_ = UNREGISTERED; // expired
                 throw FutureTimeout();
+            }
             state_ = DONE;
             break;
         case DONE:
@@ -118,7 +307,7 @@ protected:
         default:
             break;
         }
-        return result;
+        return _get();
     }
 
     bool isReady() const final
@@ -135,6 +324,20 @@ protected:
     }
 
 private:
+    template <class U = value_t>
+    typename std::enable_if<std::is_copy_constructible<U>::value, U>::type
+        _get()
+    {
+        return result;
+    }
+
+    template <class U = value_t>
+    typename std::enable_if<!std::is_copy_constructible<U>::value, U>::type
+        _get()
+    {
+        return std::move(result);
+    }
+
     RequestHandler& handler_;
     enum State
     {
@@ -154,7 +357,11 @@ inline void Request<void>::Impl::wait(const uint32_t timeout)
         throw UnregisteredRequest();
     case UNRESOLVED:
         if (!handler_.waitRequest(request, result, timeout))
+        {
+            if (!handler_.isRequestPending(request))
+                state_ = UNREGISTERED; // expired
             throw FutureTimeout();
+        }
         state_ = DONE;
     /* falls through */
     case DONE:;
@@ -170,8 +377,15 @@ inline Request<T>::Request(RequestHandler& handler, const uint32_t request)
 template <class T>
 inline Request<T>::~Request()
 {
-    if (static_cast<const Impl*>(this->impl_.get())->isUnresolved())
+    if (!static_cast<const Impl*>(this->impl_.get())->isUnresolved())
+        return;
+    try
+    {
         this->wait();
+    }
+    catch (const FutureTimeout&) // expired
+    {
+    }
 }
 
 template <class T>
@@ -185,6 +399,38 @@ inline void Request<T>::unregister()
 {
     static_cast<Impl*>(this->impl_.get())->unregister();
 }
+
+template <class T>
+template <class F>
+inline void Request<T>::then(F&& callback)
+{
+    static_cast<Impl*>(this->impl_.get())
+        ->then(std::forward<F>(callback), detail::RequestExpired());
+}
+
+template <class T>
+template <class F, class E>
+inline void Request<T>::then(F&& callback, E&& expired)
+{
+    static_cast<Impl*>(this->impl_.get())
+        ->then(std::forward<F>(callback), std::forward<E>(expired));
+}
+
+template <class T>
+template <class F>
+inline void Request<T>::then(ThreadPool& pool, F&& callback)
+{
+    typedef typename std::decay<F>::type Function;
+    then(detail::RequestPost<T, Function>{
+        &pool, Function(std::forward<F>(callback))});
+}
+
+template <class T>
+template <size_t S>
+inline void Request<T>::then(MTQueue<T, S>& queue)
+{
+    then(detail::RequestPush<T, S>{&queue});
+}
 } // namespace lunchbox
 
 #endif // LUNCHBOX_REQUEST_H
@@ -17,25 +17,211 @@
 
 #include "requestHandler.h"
 
-#include "scopedMutex.h"
-
 #include <lunchbox/debug.h>
-#include <lunchbox/spinLock.h>
+#include <lunchbox/futex.h>
+#include <lunchbox/task.h>
 
-#include <list>
-#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace lunchbox
 {
 //! @cond IGNORE
 namespace
 {
+// A request identifier is the slot index in the lower bits and the generation
+// of the slot in the upper bits, which invalidates stale identifiers of
+// recycled slots. Generation 0 is never used, so no identifier is 0. Slots are
+// reused round-robin and at most half of them are in use, an identifier
+// repeats after at least MAX_GENERATION * CHUNK_SIZE registrations.
+#define INDEX_BITS 16
+#define INDEX_MASK ((1u << INDEX_BITS) - 1)
+#define MAX_GENERATION ((1u << (32 - INDEX_BITS)) - 1)
+#define CHUNK_BITS 8
+#define CHUNK_SIZE (1u << CHUNK_BITS)
+#define MAX_CHUNKS ((INDEX_MASK + 1) / CHUNK_SIZE)
+#define INLINE_SIZE 64 // bytes of typed results stored in the record
+#define STATE_BITS 4     // Record::State in the lower bits of the record state
+#define STATE_MASK ((1u << STATE_BITS) - 1)
+#define TICK_BITS 3     // 8 ms resolution of the deadline wheel
+#define WHEEL_SIZE 256 // ticks per revolution of the deadline wheel
+#define NO_DEADLINE std::numeric_limits<uint64_t>::max()
+
+uint32_t _getRemaining(const std::chrono::steady_clock::time_point& start,
+                       const uint32_t timeout)
+{
+    if (timeout == LB_TIMEOUT_INDEFINITE)
+        return LB_TIMEOUT_INDEFINITE;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    return elapsed >= timeout ? 0 : timeout - uint32_t(elapsed);
+}
+
 struct Record
 {
-    Record() { lock.lock(); }
+    Record()
+        : id(0)
+        , generation(0)
+        , free(true)
+        , deadline(NO_DEADLINE)
+        , value(nullptr)
+        , valueSize(0)
+        , destroy(nullptr)
+    {
+    }
     ~Record() {}
-    std::timed_mutex lock;
+
+    enum State
+    {
+        PENDING,
+        WAITING,      // pending with a parked waiter
+        WAITING_ANY,  // pending, waitAny() or waitAll() parked on the handler,
+                      // and possibly a waiter parked on the record
+        CONTINUATION, // pending, continuation executed on serve
+        BUSY,         // result or continuation being stored
+        SERVED,
+        EXPIRED // expired or unregistered
+    };
+
+    /** @return the generation tag of the request in the record state. */
+    static uint32_t getTag(const uint32_t requestID)
+    {
+        return (requestID >> INDEX_BITS) << STATE_BITS;
+    }
+
+    std::atomic<uint32_t> id; // 0 if not registered
+    uint32_t generation;      // owned by the registering thread
+    std::atomic<bool> free;
+
+    // The State and the tag of the request in the upper bits. Operations with
+    // the identifier of an expired or recycled request see a different tag
+    // and fail, even if they found the record before it was recycled.
+    Futex state;
     void* data;
+    uint64_t deadline; // ms since the handler start, set on registration
+    Task continuation; // set while BUSY, executed on serve
+
+    /** @return the state of the given request, EXPIRED if recycled. */
+    uint32_t getState(const uint32_t tag) const
+    {
+        const uint32_t current = state.load(std::memory_order_acquire);
+        return (current & ~STATE_MASK) == tag ? current & STATE_MASK
+                                              : uint32_t(EXPIRED);
+    }
+
+    /**
+     * Move a pending request into the given state.
+     * @param previous returns the pending state.
+     * @return false if the request is not pending.
+     */
+    bool finish(const uint32_t tag, const State to, uint32_t& previous)
+    {
+        uint32_t current = state.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if ((current & ~STATE_MASK) != tag)
+            {
+                previous = EXPIRED;
+                return false;
+            }
+            previous = current & STATE_MASK;
+            if (previous == BUSY)
+            {
+                std::this_thread::yield();
+                current = state.load(std::memory_order_acquire);
+                continue;
+            }
+            if (previous > BUSY)
+                return false;
+            if (state.compare_exchange_weak(current, tag | to,
+                                            std::memory_order_acq_rel))
+            {
+                return true;
+            }
+        }
+    }
+
+    /** Publish the result, enters the kernel only if a waiter is parked. */
+    void publish(const uint32_t tag, const uint32_t previous)
+    {
+        state.store(tag | SERVED, std::memory_order_release);
+        if (previous == WAITING || previous == WAITING_ANY)
+            state.wakeAll();
+    }
+
+    /**
+     * Mark the record for a waiter on the handler. A record left WAITING by
+     * a timed out wait() is marked as well. @return the state.
+     */
+    uint32_t watch(const uint32_t tag)
+    {
+        uint32_t current = state.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if ((current & ~STATE_MASK) != tag)
+                return EXPIRED;
+            const uint32_t code = current & STATE_MASK;
+            if (code != PENDING && code != WAITING)
+                return code;
+            if (state.compare_exchange_weak(current, tag | WAITING_ANY,
+                                            std::memory_order_acquire))
+            {
+                return WAITING_ANY;
+            }
+        }
+    }
+
+    /** @return SERVED, EXPIRED, or a pending state on timeout. */
+    uint32_t wait(const uint32_t tag, const uint32_t timeout)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t current = state.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if ((current & ~STATE_MASK) != tag)
+                return EXPIRED;
+
+            switch (current & STATE_MASK)
+            {
+            case SERVED:
+            case EXPIRED:
+                return current & STATE_MASK;
+
+            case PENDING:
+                if (state.compare_exchange_weak(current, tag | WAITING,
+                                                std::memory_order_acquire))
+                {
+                    current = tag | WAITING;
+                }
+                continue;
+
+            case WAITING_ANY: // woken by publish() like WAITING
+                break;
+
+            case BUSY:
+                std::this_thread::yield();
+                current = state.load(std::memory_order_acquire);
+                continue;
+
+            case CONTINUATION:
+                LBASSERTINFO(false, "Wait on a request with a continuation");
+                return CONTINUATION;
+            }
+
+            const uint32_t remaining = _getRemaining(start, timeout);
+            if (remaining == 0)
+                return WAITING;
+            state.wait(current, remaining);
+            current = state.load(std::memory_order_acquire);
+        }
+    }
 
     union Result {
         void* rPointer;
@@ -47,38 +233,127 @@ struct Record
             uint64_t high;
         } rUint128;
     } result;
+
+    // typed result, see RequestHandler::serveRequest( uint32_t, T&& )
+    std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type storage;
+    void* value; // inline storage, task memory or nullptr
+    size_t valueSize;
+    void (*destroy)(void*);
+
+    void* allocateValue(const size_t size)
+    {
+        return size <= INLINE_SIZE ? &storage : allocateTaskMemory(size);
+    }
+
+    void freeValue(void* ptr, const size_t size)
+    {
+        if (ptr != &storage)
+            freeTaskMemory(ptr, size);
+    }
+
+    // destroy a served, but not retrieved value
+    void resetValue()
+    {
+        if (!value)
+            return;
+        destroy(value);
+        freeValue(value, valueSize);
+        value = nullptr;
+    }
 };
-typedef std::unordered_map<uint32_t, Record*> RecordHash;
-typedef RecordHash::const_iterator RecordHashCIter;
+
+// the handler of the batch served by this thread, see serveRequests()
+thread_local const void* _batch = nullptr;
+thread_local bool _batchWakeup = false;
+
 }
 
 namespace detail
 {
+/**
+ * Registry of records in a chunked slot array. Chunks are allocated on demand
+ * and never moved or freed while the handler exists, which makes the lookup of
+ * a record wait-free. Free records are claimed by a round-robin cursor, which
+ * reuses them in approximately FIFO order. The array grows when half of the
+ * records are in use, which keeps the scan for a free record short.
+ *
+ * Deadlines are kept in a timer wheel of WHEEL_SIZE ticks. Entries are not
+ * removed when a request completes, the sweep ignores them since the tag of
+ * their request has changed, or since the request which reused their
+ * identifier has another deadline.
+ */
 class RequestHandler
 {
 public:
     RequestHandler()
-        : requestID(1)
+        : registered(0)
+        , served(0)
+        , expired(0)
+        , start(std::chrono::steady_clock::now())
+        , scheduled(0)
+        , nextTick(0)
+        , cursor(0)
+        , numSlots(0)
+        , numChunks(0)
     {
+        for (std::atomic<Record*>& chunk : chunks)
+            chunk = nullptr;
     }
 
-    uint32_t registerRequest(void* data)
+    ~RequestHandler()
     {
-        ScopedFastWrite mutex(lock);
-
-        Record* request;
-        if (freeRecords.empty())
-            request = new Record;
-        else
+        for (size_t i = 0; i < numChunks; ++i)
         {
-            request = freeRecords.front();
-            freeRecords.pop_front();
+            // destroy the results served, but never retrieved
+            Record* records = chunks[i].load();
+            for (size_t j = 0; j < CHUNK_SIZE; ++j)
+                records[j].resetValue();
+            delete[] records;
         }
+    }
+
+    uint32_t registerRequest(void* data, const uint32_t timeout)
+    {
+        sweep(false);
+
+        const uint32_t index = _claim();
+        Record& record = _getRecord(index);
+        record.data = data;
+        record.deadline = timeout == LB_TIMEOUT_INDEFINITE
+                              ? NO_DEADLINE
+                              : _getTime() + timeout;
+        record.generation = record.generation % MAX_GENERATION + 1;
+        ++registered;
 
-        request->data = data;
-        requestID = (requestID + 1) % LB_MAX_UINT32;
-        requests[requestID] = request;
-        return requestID;
+        const uint32_t id = (record.generation << INDEX_BITS) | index;
+        record.state.store(Record::getTag(id) | Record::PENDING,
+                           std::memory_order_relaxed);
+        record.id.store(id, std::memory_order_release);
+
+        if (record.deadline != NO_DEADLINE)
+            _schedule(id, record.deadline);
+        return id;
+    }
+
+    /** @return the registered record of the request, or nullptr. */
+    Record* find(const uint32_t requestID) const
+    {
+        const uint32_t index = requestID & INDEX_MASK;
+        const uint32_t chunk = index >> CHUNK_BITS;
+        if (chunk >= MAX_CHUNKS)
+            return nullptr;
+
+        Record* records = chunks[chunk].load(std::memory_order_acquire);
+        if (!records)
+            return nullptr;
+
+        Record* record = &records[index & (CHUNK_SIZE - 1)];
+        if (requestID == 0 ||
+            record->id.load(std::memory_order_acquire) != requestID)
+        {
+            return nullptr;
+        }
+        return record;
     }
 
     bool waitRequest(const uint32_t requestID_, Record::Result& result,
@@ -86,51 +361,438 @@ public:
     {
         result.rUint128.low = 0;
         result.rUint128.high = 0;
-        Record* request = 0;
+        return waitRequest(requestID_, timeout, [&result](Record& request) {
+            result = request.result;
+            return !request.value; // not served with a typed result
+        });
+    }
+
+    /**
+     * Wait for the request, retrieve its result and unregister it. The wait
+     * ends at the deadline of the request, which then expires without
+     * waiting for a sweep.
+     * @param retrieve returns false if the served result has another kind.
+     */
+    template <class F>
+    bool waitRequest(const uint32_t requestID_, const uint32_t timeout,
+                     const F& retrieve)
+    {
+        Record* request = find(requestID_);
+        if (!request)
+            return false;
+
+        const uint32_t tag = Record::getTag(requestID_);
+        const uint64_t deadline = request->deadline;
+        const auto begin = std::chrono::steady_clock::now();
+        for (;;)
         {
-            ScopedFastWrite mutex(lock);
-            RecordHashCIter i = requests.find(requestID_);
-            if (i == requests.end())
+            uint32_t remaining = _getRemaining(begin, timeout);
+            bool atDeadline = false;
+            if (deadline != NO_DEADLINE)
+            {
+                const uint64_t now = _getTime();
+                const uint64_t left = deadline > now ? deadline - now : 0;
+                if (left < remaining)
+                {
+                    remaining = uint32_t(left);
+                    atDeadline = true;
+                }
+            }
+
+            switch (request->wait(tag, remaining))
+            {
+            case Record::SERVED:
+            {
+                const bool retrieved = retrieve(*request);
+                unregisterRequest(requestID_);
+                return retrieved;
+            }
+            case Record::EXPIRED:
+                unregisterRequest(requestID_);
                 return false;
+            default:
+                if (!atDeadline)
+                    return false;
+                expire(requestID_); // or served concurrently
+            }
+        }
+    }
+
+    void unregisterRequest(const uint32_t requestID_)
+    {
+        Record* request = find(requestID_);
+        if (!request)
+            return;
+
+        // waits for a concurrent serve, which may not touch the record after
+        uint32_t previous;
+        request->finish(Record::getTag(requestID_), Record::EXPIRED, previous);
+
+        uint32_t id = requestID_;
+        if (!request->id.compare_exchange_strong(id, 0))
+            return; // concurrently unregistered
+
+        request->continuation = nullptr;
+        request->resetValue();
+        --registered;
+        request->free.store(true, std::memory_order_release);
+    }
 
-            request = i->second;
+    /**
+     * Serve a request, waking a waiter or executing its continuation.
+     * @param write stores the result in the record.
+     */
+    template <class F>
+    void serve(const uint32_t requestID, const F& write)
+    {
+        Record* request = find(requestID);
+        if (!request)
+            return;
+
+        const uint32_t tag = Record::getTag(requestID);
+        uint32_t previous;
+        if (!request->finish(tag, Record::BUSY, previous))
+            return; // expired or already served
+
+        try
+        {
+            write(*request);
+        }
+        catch (...)
+        {
+            request->state.store(tag | previous, std::memory_order_release);
+            throw;
         }
+        request->publish(tag, previous);
+        served.fetch_add(1, std::memory_order_relaxed);
 
-        if (timeout == LB_TIMEOUT_INDEFINITE) // opt
+        switch (previous)
         {
-            request->lock.lock();
-            result = request->result;
-            unregisterRequest(requestID_);
+        case Record::WAITING_ANY:
+            if (_batch == this)
+                _batchWakeup = true;
+            else
+                wakeup();
+            return;
+
+        case Record::CONTINUATION:
+        {
+            // the continuation unregisters the record, which may be reused
+            Task task(std::move(request->continuation));
+            task();
+            return;
+        }
+        default:
+            return;
+        }
+    }
+
+    bool setContinuation(const uint32_t requestID, Task&& continuation)
+    {
+        Record* request = find(requestID);
+        if (!request)
+            return false;
+
+        const uint32_t tag = Record::getTag(requestID);
+        uint32_t previous;
+        if (request->finish(tag, Record::BUSY, previous))
+        {
+            LBASSERTINFO(previous != Record::WAITING,
+                         "Continuation on a waited request");
+            request->continuation = std::move(continuation);
+            request->state.store(tag | Record::CONTINUATION,
+                                 std::memory_order_release);
             return true;
         }
 
-        const bool requestServed =
-            request->lock.try_lock_for(std::chrono::milliseconds(timeout));
-        if (requestServed)
+        if (previous != Record::SERVED)
+            return false; // expired
+
+        continuation();
+        return true;
+    }
+
+    /** Expire the request. @return true if it was pending. */
+    bool expire(const uint32_t requestID)
+    {
+        Task continuation;
+        if (!expire(requestID, continuation))
+            return false;
+        if (continuation)
+            continuation();
+        return true;
+    }
+
+    /**
+     * Expire the request, without executing its continuation.
+     * @param continuation receives the continuation of the request, which
+     *        the caller executes to report the failure.
+     * @return true if the request was pending.
+     */
+    bool expire(const uint32_t requestID, Task& continuation)
+    {
+        Record* request = find(requestID);
+        if (!request)
+            return false;
+
+        uint32_t previous;
+        if (!request->finish(Record::getTag(requestID), Record::EXPIRED,
+                             previous))
         {
-            result = request->result;
-            unregisterRequest(requestID_);
+            return false;
         }
 
-        return requestServed;
+        expired.fetch_add(1, std::memory_order_relaxed);
+        if (previous == Record::WAITING || previous == Record::WAITING_ANY)
+            request->state.wakeAll();
+        else if (previous == Record::CONTINUATION)
+            continuation = std::move(request->continuation);
+        unregisterRequest(requestID);
+        if (previous == Record::WAITING_ANY)
+            wakeup();
+        return true;
     }
 
-    void unregisterRequest(const uint32_t requestID_)
+    /**
+     * Expire the requests of all elapsed ticks of the wheel.
+     * @param force wait for a concurrent sweep, otherwise skip it.
+     * @return the number of expired requests.
+     */
+    size_t sweep(const bool force)
     {
-        ScopedFastWrite mutex(lock);
-        RecordHash::iterator i = requests.find(requestID_);
-        if (i == requests.end())
-            return;
+        if (scheduled.load(std::memory_order_relaxed) == 0)
+            return 0;
 
-        Record* request = i->second;
-        requests.erase(i);
-        freeRecords.push_front(request);
+        const uint64_t tick = _getTime() >> TICK_BITS;
+        if (tick <= nextTick.load(std::memory_order_relaxed))
+            return 0;
+
+        std::unique_lock<std::mutex> lock(wheelLock, std::defer_lock);
+        if (force)
+            lock.lock();
+        else if (!lock.try_lock())
+            return 0;
+
+        // Entries of later revolutions stay. If more than a revolution has
+        // elapsed, each slot is visited once. Continuations are executed
+        // after unlocking, since they may register timed requests.
+        std::vector<Task> continuations;
+        size_t numExpired = 0;
+        const uint64_t end = std::min(tick, nextTick + WHEEL_SIZE);
+        for (uint64_t i = nextTick; i < end; ++i)
+        {
+            std::vector<Deadline>& slot = wheel[i % WHEEL_SIZE];
+            for (size_t j = 0; j < slot.size();)
+            {
+                if ((slot[j].time >> TICK_BITS) >= tick)
+                {
+                    ++j;
+                    continue;
+                }
+                // a stale entry of a recycled identifier has another deadline
+                const Record* request = find(slot[j].requestID);
+                Task continuation;
+                if (request && request->deadline == slot[j].time)
+                    numExpired += expire(slot[j].requestID, continuation);
+                if (continuation)
+                    continuations.push_back(std::move(continuation));
+                slot[j] = slot.back();
+                slot.pop_back();
+                --scheduled;
+            }
+        }
+        nextTick = tick;
+        lock.unlock();
+
+        for (Task& continuation : continuations)
+            continuation();
+        return numExpired;
+    }
+
+    void wakeup()
+    {
+        ++completions;
+        completions.wakeAll();
+    }
+
+    /**
+     * Wait for any or all of the requests, sleeping on the completions epoch
+     * which is advanced by each serve of a watched record. Like
+     * waitRequest(), the wait ends at the earliest deadline of the pending
+     * requests, which then expire.
+     * @return true if any or all requests were served within the timeout,
+     *         false on timeout or if a request expired while waiting.
+     */
+    bool wait(const std::vector<uint32_t>& requestIDs, const bool all,
+              const uint32_t timeout, size_t& index)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        size_t unknown = requestIDs.size() + 1; // set on the first pass
+        for (;;)
+        {
+            const uint32_t epoch = completions.load(std::memory_order_acquire);
+            size_t numServed = 0;
+            size_t numExpired = 0;
+            uint64_t deadline = NO_DEADLINE;
+            for (size_t i = 0; i < requestIDs.size(); ++i)
+            {
+                const uint32_t requestID = requestIDs[i];
+                Record* request = find(requestID);
+                const uint32_t state =
+                    request ? request->watch(Record::getTag(requestID))
+                            : uint32_t(Record::EXPIRED);
+                if (state == Record::SERVED)
+                {
+                    index = i;
+                    if (!all)
+                        return true;
+                    ++numServed;
+                }
+                else if (state == Record::EXPIRED)
+                    ++numExpired;
+                else
+                    deadline = std::min(deadline, request->deadline);
+            }
+
+            // Unknown requests are ignored by any and complete for all, but
+            // requests expiring while waiting fail the wait
+            if (unknown > requestIDs.size())
+                unknown = numExpired;
+            if (all && numExpired > unknown)
+                return false;
+            if (numServed + numExpired == requestIDs.size())
+                return all;
+
+            uint32_t remaining = _getRemaining(begin, timeout);
+            bool atDeadline = false;
+            if (deadline != NO_DEADLINE)
+            {
+                const uint64_t now = _getTime();
+                const uint64_t left = deadline > now ? deadline - now : 0;
+                if (left < remaining)
+                {
+                    remaining = uint32_t(left);
+                    atDeadline = true;
+                }
+            }
+
+            if (remaining > 0)
+                completions.wait(epoch, remaining);
+            else if (atDeadline)
+                _expire(requestIDs, _getTime());
+            else
+                return false;
+        }
+    }
+
+    std::atomic<size_t> registered;
+    std::atomic<uint64_t> served;
+    std::atomic<uint64_t> expired;
+
+private:
+    Futex completions; // epoch, advanced when a watched record is served
+
+    struct Deadline
+    {
+        uint32_t requestID;
+        uint64_t time; // ms since start
+    };
+
+    const std::chrono::steady_clock::time_point start;
+    std::mutex wheelLock;
+    std::vector<Deadline> wheel[WHEEL_SIZE]; // protected by wheelLock
+    std::atomic<size_t> scheduled;           // entries in the wheel
+    std::atomic<uint64_t> nextTick;          // first tick not swept
+
+    uint64_t _getTime() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+    // Expire the given pending requests whose deadline is reached
+    void _expire(const std::vector<uint32_t>& requestIDs, const uint64_t now)
+    {
+        for (const uint32_t requestID : requestIDs)
+        {
+            const Record* request = find(requestID);
+            if (request && request->deadline <= now)
+                expire(requestID); // or served concurrently
+        }
+    }
+
+    void _schedule(const uint32_t requestID, const uint64_t time)
+    {
+        const uint64_t tick = time >> TICK_BITS;
+        std::unique_lock<std::mutex> lock(wheelLock);
+        // start an empty wheel at this tick, and don't skip an elapsed tick
+        if (scheduled == 0 || tick < nextTick)
+            nextTick = tick;
+        wheel[tick % WHEEL_SIZE].push_back({requestID, time});
+        ++scheduled;
     }
 
-    mutable lunchbox::SpinLock lock;
-    uint32_t requestID;
-    RecordHash requests;
-    std::list<Record*> freeRecords;
+    std::atomic<Record*> chunks[MAX_CHUNKS];
+    std::atomic<uint32_t> cursor;   // next slot tried by _claim()
+    std::atomic<uint32_t> numSlots; // allocated records
+    size_t numChunks;               // protected by growLock
+    std::mutex growLock;
+
+    Record& _getRecord(const uint32_t index) const
+    {
+        return chunks[index >> CHUNK_BITS].load(
+            std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+    }
+
+    /** @return the index of a free record, now owned by the caller. */
+    uint32_t _claim()
+    {
+        for (;;)
+        {
+            const uint32_t slots = numSlots.load(std::memory_order_acquire);
+            if (slots < MAX_CHUNKS * CHUNK_SIZE &&
+                registered.load(std::memory_order_relaxed) * 2 >= slots)
+            {
+                _grow(slots);
+                continue;
+            }
+
+            for (uint32_t i = 0; i < slots; ++i)
+            {
+                const uint32_t index =
+                    cursor.fetch_add(1, std::memory_order_relaxed) % slots;
+                Record& record = _getRecord(index);
+                bool free = true;
+                if (record.free.load(std::memory_order_relaxed) &&
+                    record.free.compare_exchange_strong(
+                        free, false, std::memory_order_acquire))
+                {
+                    return index;
+                }
+            }
+
+            LBASSERTINFO(slots < MAX_CHUNKS * CHUNK_SIZE,
+                         "Too many pending requests");
+            if (slots >= MAX_CHUNKS * CHUNK_SIZE)
+                throw std::runtime_error("Too many pending requests");
+            _grow(slots);
+        }
+    }
+
+    // Add a chunk of free records, unless another thread just did
+    void _grow(const uint32_t slots)
+    {
+        std::unique_lock<std::mutex> lock(growLock);
+        if (numSlots.load() != slots || numChunks >= MAX_CHUNKS)
+            return;
+
+        chunks[numChunks].store(new Record[CHUNK_SIZE],
+                                std::memory_order_release);
+        ++numChunks;
+        numSlots.store(uint32_t(numChunks) << CHUNK_BITS,
+                       std::memory_order_release);
+    }
 };
 }
 // @endcond
@@ -142,18 +804,95 @@ RequestHandler::RequestHandler()
 
 RequestHandler::~RequestHandler()
 {
-    while (!_impl->freeRecords.empty())
-    {
-        Record* request = _impl->freeRecords.front();
-        _impl->freeRecords.pop_front();
-        delete request;
-    }
     delete _impl;
 }
 
-uint32_t RequestHandler::_register(void* data)
+uint32_t RequestHandler::_register(void* data, const uint32_t timeout)
 {
-    return _impl->registerRequest(data);
+    return _impl->registerRequest(data, timeout);
+}
+
+void RequestHandler::_serve(const uint32_t requestID, const size_t size,
+                            void (*construct)(void*, void*), void* from,
+                            void (*destroy)(void*))
+{
+    _impl->serve(requestID, [=](Record& request) {
+        LBASSERTINFO(!request.value, "Request served twice");
+        void* value = request.allocateValue(size);
+        try
+        {
+            construct(value, from);
+        }
+        catch (...)
+        {
+            request.freeValue(value, size);
+            throw;
+        }
+
+        request.value = value;
+        request.valueSize = size;
+        request.destroy = destroy;
+    });
+}
+
+bool RequestHandler::_wait(const uint32_t requestID, const size_t size,
+                           void (*take)(void*, void*), void* to,
+                           const uint32_t timeout)
+{
+    return _impl->waitRequest(requestID, timeout, [=](Record& request) {
+        if (!request.value || request.valueSize != size)
+            return false; // not served with a result of the waited type
+
+        take(request.value, to);
+        request.freeValue(request.value, request.valueSize);
+        request.value = nullptr;
+        return true;
+    });
+}
+
+bool RequestHandler::_setContinuation(const uint32_t requestID,
+                                      Task&& continuation)
+{
+    return _impl->setContinuation(requestID, std::move(continuation));
+}
+
+bool RequestHandler::_beginBatch()
+{
+    if (_batch) // nested, e.g., from a continuation served in a batch
+        return false;
+    _batch = _impl;
+    _batchWakeup = false;
+    return true;
+}
+
+void RequestHandler::_endBatch()
+{
+    _batch = nullptr;
+    if (_batchWakeup)
+        _impl->wakeup();
+    _batchWakeup = false;
+}
+
+void RequestHandler::serveRequests(const std::vector<uint32_t>& requestIDs)
+{
+    Batch batch(*this);
+    for (const uint32_t requestID : requestIDs)
+        serveRequest(requestID);
+}
+
+size_t RequestHandler::waitAny(const std::vector<uint32_t>& requestIDs,
+                               const uint32_t timeout)
+{
+    size_t index = requestIDs.size();
+    return _impl->wait(requestIDs, false, timeout, index) ? index
+                                                          : requestIDs.size();
+}
+
+bool RequestHandler::waitAll(const std::vector<uint32_t>& requestIDs,
+                             const uint32_t timeout)
+{
+    size_t index;
+    return _impl->wait(requestIDs, true, timeout, index);
 }
 
 void RequestHandler::unregisterRequest(const uint32_t requestID)
@@ -208,107 +947,78 @@ bool RequestHandler::waitRequest(const uint32_t requestID, bool& rBool,
 
 bool RequestHandler::waitRequest(const uint32_t requestID)
 {
-    Record::Result result;
-    return _impl->waitRequest(requestID, result, LB_TIMEOUT_INDEFINITE);
+    // any result is discarded by unregisterRequest()
+    return _impl->waitRequest(requestID, LB_TIMEOUT_INDEFINITE,
+                              [](Record&) { return true; });
 }
 
 void* RequestHandler::getRequestData(const uint32_t requestID)
 {
-    ScopedFastWrite mutex(_impl->lock);
-    RecordHashCIter i = _impl->requests.find(requestID);
-    if (i == _impl->requests.end())
-        return 0;
-
-    return i->second->data;
+    const Record* request = _impl->find(requestID);
+    return request ? request->data : 0;
 }
 
 void RequestHandler::serveRequest(const uint32_t requestID, void* result)
 {
-    Record* request = 0;
-    {
-        ScopedFastWrite mutex(_impl->lock);
-        RecordHashCIter i = _impl->requests.find(requestID);
-
-        if (i != _impl->requests.end())
-            request = i->second;
-    }
-    if (request)
-    {
-        request->result.rPointer = result;
-        request->lock.unlock();
-    }
+    _impl->serve(requestID, [result](Record& request) {
+        request.result.rPointer = result;
+    });
 }
 
 void RequestHandler::serveRequest(const uint32_t requestID, uint32_t result)
 {
-    Record* request = 0;
-    {
-        ScopedFastWrite mutex(_impl->lock);
-        RecordHashCIter i = _impl->requests.find(requestID);
-
-        if (i != _impl->requests.end())
-            request = i->second;
-    }
-    if (request)
-    {
-        request->result.rUint32 = result;
-        request->lock.unlock();
-    }
+    _impl->serve(requestID, [result](Record& request) {
+        request.result.rUint32 = result;
+    });
 }
 
 void RequestHandler::serveRequest(const uint32_t requestID, bool result)
 {
-    Record* request = 0;
-    {
-        ScopedFastWrite mutex(_impl->lock);
-        RecordHashCIter i = _impl->requests.find(requestID);
-
-        if (i != _impl->requests.end())
-            request = i->second;
-    }
-    if (request)
-    {
-        request->result.rBool = result;
-        request->lock.unlock();
-    }
+    _impl->serve(requestID, [result](Record& request) {
+        request.result.rBool = result;
+    });
 }
 
 void RequestHandler::serveRequest(const uint32_t requestID,
                                   const servus::uint128_t& result)
 {
-    Record* request = 0;
-    {
-        ScopedFastWrite mutex(_impl->lock);
-        RecordHashCIter i = _impl->requests.find(requestID);
-
-        if (i != _impl->requests.end())
-            request = i->second;
-    }
-
-    if (request)
-    {
-        request->result.rUint128.low = result.low();
-        request->result.rUint128.high = result.high();
-        request->lock.unlock();
-    }
+    _impl->serve(requestID, [&result](Record& request) {
+        request.result.rUint128.low = result.low();
+        request.result.rUint128.high = result.high();
+    });
 }
 
 bool RequestHandler::isRequestReady(const uint32_t requestID) const
 {
-    ScopedFastWrite mutex(_impl->lock);
-    RecordHashCIter i = _impl->requests.find(requestID);
-    if (i == _impl->requests.end())
-        return false;
+    const Record* request = _impl->find(requestID);
+    return request &&
+           request->getState(Record::getTag(requestID)) == Record::SERVED;
+}
 
-    Record* request = i->second;
-    const bool isReady = request->lock.try_lock();
-    if (isReady)
-        request->lock.unlock();
-    return isReady;
+bool RequestHandler::isRequestPending(const uint32_t requestID) const
+{
+    const Record* request = _impl->find(requestID);
+    return request &&
+           request->getState(Record::getTag(requestID)) < Record::SERVED;
 }
 
 bool RequestHandler::hasPendingRequests() const
 {
-    return !_impl->requests.empty();
+    _impl->sweep(false);
+    return _impl->registered > 0;
+}
+
+size_t RequestHandler::expireRequests()
+{
+    return _impl->sweep(true);
+}
+
+RequestHandler::Statistics RequestHandler::getStatistics() const
+{
+    Statistics statistics;
+    statistics.outstanding = _impl->registered;
+    statistics.served = _impl->served.load(std::memory_order_relaxed);
+    statistics.expired = _impl->expired.load(std::memory_order_relaxed);
+    return statistics;
 }
 }
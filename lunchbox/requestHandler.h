@@ -19,15 +19,59 @@
 #define LUNCHBOX_REQUESTHANDLER_H
 
 #include <lunchbox/api.h>    // LUNCHBOX_API definition
+#include <lunchbox/task.h>   // used inline
 #include <lunchbox/thread.h> // thread-safety macros
 #include <lunchbox/types.h>
 #include <servus/uint128_t.h>
 
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace lunchbox
 {
 namespace detail
 {
 class RequestHandler;
+
+/**
+ * Result types served and waited for by the typed RequestHandler API. Pointer,
+ * arithmetic and enum types are left to the untyped API, which converts them
+ * or rejects them as ambiguous.
+ */
+template <class T>
+struct IsTypedResult
+{
+    typedef typename std::decay<T>::type D;
+    static const bool value = !std::is_pointer<D>::value &&
+                              !std::is_same<D, std::nullptr_t>::value &&
+                              !std::is_arithmetic<D>::value &&
+                              !std::is_enum<D>::value &&
+                              !std::is_same<D, servus::uint128_t>::value;
+};
+
+template <class T, class A>
+void constructResult(void* to, void* from)
+{
+    typedef typename std::remove_reference<A>::type Arg;
+    new (to) T(std::forward<A>(*static_cast<Arg*>(from)));
+}
+
+template <class T>
+void destroyResult(void* ptr)
+{
+    static_cast<T*>(ptr)->~T();
+}
+
+template <class T>
+void takeResult(void* from, void* to)
+{
+    T& value = *static_cast<T*>(from);
+    *static_cast<T*>(to) = std::move(value);
+    value.~T();
+}
 }
 
 /**
@@ -42,11 +86,41 @@ class RequestHandler;
  * functions serveRequest() and deleteRequest() are supposed to be called only
  * from one 'serving' thread.
  *
+ * Besides the untyped results void*, uint32_t, bool and uint128_t, requests
+ * can be served with a value of any movable type. The value is stored in the
+ * pooled request record, inline if it is small, and moved out on wait, which
+ * avoids memory allocations for small results.
+ *
+ * A serving thread completing many requests at once, e.g., an I/O thread
+ * processing a batch of replies, uses serveRequests(). A waiting thread
+ * gathering many requests uses waitAny() or waitAll(), which sleep on a single
+ * wakeup of the handler instead of once per request. A batch wakes such a
+ * waiter only once.
+ *
+ * Instead of blocking a thread in waitRequest(), a continuation may be set for
+ * a request. It is executed by the thread serving the request, which allows
+ * many requests in flight with few threads. Request::then() builds on this to
+ * call a function with the result, or to route it to a ThreadPool or MTQueue.
+ *
+ * Requests may be registered with a timeout. Requests not served before their
+ * deadline expire: they are unregistered, and waiting on them fails. Expired
+ * requests are collected by a timer wheel with a resolution of a few
+ * milliseconds, swept during registerRequest(), hasPendingRequests() and
+ * expireRequests().
+ *
  * Example: @include tests/requestHandler.cpp
  */
 class RequestHandler : public boost::noncopyable
 {
 public:
+    /** Request counters of a handler. @version 1.18 */
+    struct Statistics
+    {
+        size_t outstanding; //!< registered requests
+        uint64_t served;    //!< served requests
+        uint64_t expired;   //!< requests expired after their timeout
+    };
+
     /** Construct a new request handler.  @version 1.0 */
     LUNCHBOX_API RequestHandler();
 
@@ -71,7 +145,37 @@ public:
      * @version 1.0
      * @deprecated use the future-based registerRequest()
      */
-    uint32_t registerRequest(void* data = 0) { return _register(data); }
+    uint32_t registerRequest(void* data = 0)
+    {
+        return _register(data, LB_TIMEOUT_INDEFINITE);
+    }
+
+    /**
+     * Register a request which expires after the given time.
+     *
+     * An expired request is unregistered, and a pending or later wait on it
+     * returns false, or throws FutureTimeout for a Request. The continuation of
+     * an expired request is executed by the expiring thread, and fails to
+     * retrieve the result.
+     *
+     * @param data a pointer to user-specific data for the request, can be 0.
+     * @param timeout the time in milliseconds until the request expires.
+     * @return the request identifier.
+     * @version 1.18
+     */
+    uint32_t registerRequest(void* data, const uint32_t timeout)
+    {
+        return _register(data, timeout);
+    }
+
+    /**
+     * Register a request which expires after the given time.
+     * @return A Future which will be fulfilled on serveRequest().
+     * @version 1.18
+     */
+    template <class T>
+    Request<T> registerRequest(void* data, uint32_t timeout);
+
     /**
      * Unregister a request.
      *
@@ -95,7 +199,8 @@ public:
      * @param timeout the timeout in milliseconds to wait for the request,
      *                or <code>LB_TIMEOUT_INDEFINITE</code> to wait
      *                indefinitely.
-     * @return true if the request was served, false if not.
+     * @return true if the request was served, false if not or if it was
+     *         served with a typed result.
      * @version 1.0
      */
     LUNCHBOX_API bool waitRequest(
@@ -141,18 +246,172 @@ public:
     /** Serve a request with an uint128_t result. @version 1.0 */
     LUNCHBOX_API void serveRequest(const uint32_t requestID,
                                    const servus::uint128_t& result);
+
+    /**
+     * Serve a request with a result of any other type, except arithmetic and
+     * enum types.
+     *
+     * The result is copied or moved into the request, and has to be retrieved
+     * with the waitRequest() or Request<T> of the same type.
+     *
+     * @param requestID the request identifier.
+     * @param result the result of the request.
+     * @version 1.18
+     */
+    template <class T, class = typename std::enable_if<
+                           detail::IsTypedResult<T>::value>::type>
+    void serveRequest(const uint32_t requestID, T&& result);
+
+    /**
+     * Wait for a request with a result of any other type.
+     *
+     * @param requestID the request identifier.
+     * @param result the result, move-assigned from the served value.
+     * @param timeout the timeout in milliseconds to wait for the request.
+     * @return true if the request was served, false if not or if it was
+     *         served with a result of another type.
+     * @sa serveRequest(const uint32_t, T&&)
+     * @version 1.18
+     */
+    template <class T, class = typename std::enable_if<
+                           detail::IsTypedResult<T>::value>::type>
+    bool waitRequest(const uint32_t requestID, T& result,
+                     const uint32_t timeout = LB_TIMEOUT_INDEFINITE);
+
+    /**
+     * Serve a batch of requests.
+     *
+     * Equivalent to calling serveRequest() for each request, but a waitAny()
+     * or waitAll() caller waiting on several of the requests is woken only
+     * once, after all requests have been served.
+     *
+     * @param requestIDs the request identifiers.
+     * @param results the result for each request, copied.
+     * @version 1.18
+     */
+    template <class T>
+    void serveRequests(const std::vector<uint32_t>& requestIDs,
+                       const std::vector<T>& results);
+
+    /** Serve a batch of requests, moving the results. @version 1.18 */
+    template <class T>
+    void serveRequests(const std::vector<uint32_t>& requestIDs,
+                       std::vector<T>&& results);
+
+    /** Serve a batch of requests without a result. @version 1.18 */
+    LUNCHBOX_API void serveRequests(const std::vector<uint32_t>& requestIDs);
+
+    /**
+     * Execute a task once the request is served, instead of waiting for it.
+     *
+     * The task is executed by the thread serving the request, or immediately
+     * by the calling thread if the request is already served. It retrieves the
+     * result and unregisters the request using a non-blocking waitRequest(),
+     * and should not block the serving thread. The request may not be waited
+     * for otherwise. If the request expires, the task is executed by the
+     * expiring thread and waitRequest() returns false.
+     *
+     * @param requestID the request identifier.
+     * @param task the continuation.
+     * @return false if the request is not registered or expired, and the task
+     *         is not executed, true otherwise.
+     * @version 1.18
+     */
+    template <class F>
+    bool setContinuation(const uint32_t requestID, F&& task)
+    {
+        return _setContinuation(requestID, Task(std::forward<F>(task)));
+    }
+
+    /**
+     * Wait a given time for the completion of any of the given requests.
+     *
+     * The requests stay registered, and the result of the completed request
+     * is retrieved without blocking using waitRequest(). Unknown and expired
+     * requests are ignored, requests reaching their deadline while waiting
+     * expire. The requests may not be waited for concurrently by another
+     * thread.
+     *
+     * @param requestIDs the request identifiers.
+     * @param timeout the timeout in milliseconds to wait for the requests.
+     * @return the index of a served request in requestIDs, or
+     *         requestIDs.size() if none was served within the timeout or
+     *         none is pending anymore.
+     * @version 1.18
+     */
+    LUNCHBOX_API size_t waitAny(const std::vector<uint32_t>& requestIDs,
+                                uint32_t timeout = LB_TIMEOUT_INDEFINITE);
+
+    /**
+     * Wait a given time for the completion of all given requests.
+     *
+     * The requests stay registered, and their results are retrieved without
+     * blocking using waitRequest(). Unknown requests are considered complete.
+     * Requests reaching their deadline while waiting expire and fail the wait.
+     * The requests may not be waited for concurrently by another thread.
+     *
+     * @param requestIDs the request identifiers.
+     * @param timeout the timeout in milliseconds to wait for the requests.
+     * @return true if all requests were served, false on timeout or if a
+     *         request expired.
+     * @version 1.18
+     */
+    LUNCHBOX_API bool waitAll(const std::vector<uint32_t>& requestIDs,
+                              uint32_t timeout = LB_TIMEOUT_INDEFINITE);
+
     /**
      * @return true if this request handler has pending requests.
      * @version 1.0
      */
     LUNCHBOX_API bool hasPendingRequests() const;
 
-    LUNCHBOX_API bool isRequestReady(const uint32_t) const; //!< @internal
+    /**
+     * Expire all requests whose timeout has elapsed.
+     * @return the number of expired requests.
+     * @version 1.18
+     */
+    LUNCHBOX_API size_t expireRequests();
+
+    /** @return the request counters of this handler. @version 1.18 */
+    LUNCHBOX_API Statistics getStatistics() const;
+
+    LUNCHBOX_API bool isRequestReady(const uint32_t) const;   //!< @internal
+    LUNCHBOX_API bool isRequestPending(const uint32_t) const; //!< @internal
 
 private:
     detail::RequestHandler* const _impl;
 
-    LUNCHBOX_API uint32_t _register(void* data);
+    LUNCHBOX_API uint32_t _register(void* data, uint32_t timeout);
+    LUNCHBOX_API void _serve(const uint32_t requestID, const size_t size,
+                             void (*construct)(void*, void*), void* from,
+                             void (*destroy)(void*));
+    LUNCHBOX_API bool _wait(const uint32_t requestID, const size_t size,
+                            void (*take)(void*, void*), void* to,
+                            const uint32_t timeout);
+    LUNCHBOX_API bool _setContinuation(const uint32_t requestID,
+                                       Task&& continuation);
+    LUNCHBOX_API bool _beginBatch();
+    LUNCHBOX_API void _endBatch();
+
+    /** Serves the requests of its lifetime as one batch, unless nested. */
+    class Batch : public boost::noncopyable
+    {
+    public:
+        explicit Batch(RequestHandler& handler)
+            : _handler(handler)
+            , _started(handler._beginBatch())
+        {
+        }
+        ~Batch()
+        {
+            if (_started)
+                _handler._endBatch();
+        }
+
+    private:
+        RequestHandler& _handler;
+        const bool _started;
+    };
     LB_TS_VAR(_thread);
 };
 }
@@ -164,7 +423,56 @@ namespace lunchbox
 template <class T>
 inline Request<T> RequestHandler::registerRequest(void* data)
 {
-    return Request<T>(*this, _register(data));
+    return Request<T>(*this, _register(data, LB_TIMEOUT_INDEFINITE));
+}
+
+template <class T>
+inline Request<T> RequestHandler::registerRequest(void* data,
+                                                  const uint32_t timeout)
+{
+    return Request<T>(*this, _register(data, timeout));
+}
+
+template <class T, class>
+inline void RequestHandler::serveRequest(const uint32_t requestID, T&& result)
+{
+    typedef typename std::decay<T>::type Value;
+    static_assert(alignof(Value) <= alignof(std::max_align_t),
+                  "Over-aligned request results are not supported");
+    _serve(requestID, sizeof(Value), &detail::constructResult<Value, T&&>,
+           const_cast<void*>(static_cast<const void*>(&result)),
+           &detail::destroyResult<Value>);
+}
+
+template <class T>
+inline void RequestHandler::serveRequests(
+    const std::vector<uint32_t>& requestIDs, const std::vector<T>& results)
+{
+    LBASSERT(requestIDs.size() == results.size());
+    Batch batch(*this);
+    for (size_t i = 0; i < requestIDs.size(); ++i)
+    {
+        const T& result = results[i];
+        serveRequest(requestIDs[i], result);
+    }
+}
+
+template <class T>
+inline void RequestHandler::serveRequests(
+    const std::vector<uint32_t>& requestIDs, std::vector<T>&& results)
+{
+    LBASSERT(requestIDs.size() == results.size());
+    Batch batch(*this);
+    for (size_t i = 0; i < requestIDs.size(); ++i)
+        serveRequest(requestIDs[i], std::move(results[i]));
+}
+
+template <class T, class>
+inline bool RequestHandler::waitRequest(const uint32_t requestID, T& result,
+                                        const uint32_t timeout)
+{
+    return _wait(requestID, sizeof(T), &detail::takeResult<T>, &result,
+                 timeout);
 }
 }
 
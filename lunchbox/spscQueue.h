@@ -0,0 +1,135 @@
+
+/* Copyright (c) 2010-2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_SPSCQUEUE_H
+#define LUNCHBOX_SPSCQUEUE_H
+
+#include <lunchbox/compiler.h> // LB_CACHELINE_SIZE
+#include <lunchbox/debug.h>    // used in inline method
+#include <lunchbox/thread.h>   // thread-safety checks
+
+#include <atomic>
+#include <vector>
+
+namespace lunchbox
+{
+/**
+ * A high-throughput, lock-free single producer, single consumer queue.
+ *
+ * Functionally equivalent to LFQueue, but optimized for sustained traffic
+ * between two threads: the read and write positions live on separate cache
+ * lines, each side caches the last seen position of its peer and only reloads
+ * it when the queue appears to be empty or full, and the ring buffer has a
+ * power-of-two size to replace the modulo by a mask.
+ *
+ * Current implementation constraints:
+ * * One reader thread
+ * * One writer thread
+ * * Fixed maximum size (writes may fail)
+ * * Not copyable
+ *
+ * Example: @include tests/spscQueue.cpp
+ */
+template <typename T>
+class SPSCQueue : public boost::noncopyable
+{
+public:
+    /** Construct a new queue. @version 1.18 */
+    explicit SPSCQueue(const size_t size);
+
+    /** Destruct this queue. @version 1.18 */
+    ~SPSCQueue() {}
+    /** @return true if the queue is empty, false otherwise. @version 1.18 */
+    bool isEmpty() const;
+
+    /** Reset (empty) the queue from the reader thread. @version 1.18 */
+    void clear();
+
+    /**
+     * Resize and reset the queue.
+     *
+     * This method is not thread-safe. The queue has to be empty.
+     * @version 1.18
+     */
+    void resize(const size_t size);
+
+    /**
+     * Retrieve and pop the front element from the queue.
+     *
+     * @param result the front value or unmodified
+     * @return true if an element was placed in result, false if the queue
+     *         is empty.
+     * @version 1.18
+     */
+    bool pop(T& result);
+
+    /**
+     * Retrieve the front element from the queue.
+     *
+     * @param result the front value or unmodified
+     * @return true if an element was placed in result, false if the queue
+     *         is empty.
+     * @version 1.18
+     */
+    bool getFront(T& result);
+
+    /**
+     * Push a new element to the back of the queue.
+     *
+     * @param element the element to add.
+     * @return true if the element was placed, false if the queue is full
+     * @version 1.18
+     */
+    bool push(const T& element);
+
+    /**
+     * @return the maximum number of elements held by the queue.
+     * @version 1.18
+     */
+    size_t getCapacity() const { return _capacity; }
+private:
+    char _pad0[LB_CACHELINE_SIZE];
+
+    // reader cache line
+    std::atomic<size_t> _readPos;
+    size_t _writeCache; // last _writePos seen by the reader
+
+    char _pad1[LB_CACHELINE_SIZE - sizeof(std::atomic<size_t>) -
+               sizeof(size_t)];
+
+    // writer cache line
+    std::atomic<size_t> _writePos;
+    size_t _readCache; // last _readPos seen by the writer
+
+    char _pad2[LB_CACHELINE_SIZE - sizeof(std::atomic<size_t>) -
+               sizeof(size_t)];
+
+    // read-only after construction
+    std::vector<T> _data;
+    size_t _mask;
+    size_t _capacity;
+
+    LB_TS_VAR(_reader);
+    LB_TS_VAR(_writer);
+
+    bool _fetchWritePos(const size_t readPos);
+};
+}
+
+#include "spscQueue.ipp" // template implementation
+
+#endif // LUNCHBOX_SPSCQUEUE_H
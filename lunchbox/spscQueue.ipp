@@ -0,0 +1,114 @@
+
+/* Copyright (c) 2010-2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+namespace lunchbox
+{
+template <typename T>
+SPSCQueue<T>::SPSCQueue(const size_t size)
+    : _readPos(0)
+    , _writeCache(0)
+    , _writePos(0)
+    , _readCache(0)
+    , _mask(0)
+    , _capacity(0)
+{
+    resize(size);
+}
+
+template <typename T>
+bool SPSCQueue<T>::isEmpty() const
+{
+    return _readPos.load(std::memory_order_acquire) ==
+           _writePos.load(std::memory_order_acquire);
+}
+
+template <typename T>
+void SPSCQueue<T>::clear()
+{
+    LB_TS_SCOPED(_reader);
+    _writeCache = _writePos.load(std::memory_order_acquire);
+    _readPos.store(_writeCache, std::memory_order_release);
+}
+
+template <typename T>
+void SPSCQueue<T>::resize(const size_t size)
+{
+    LBASSERT(isEmpty());
+
+    // positions are never wrapped, only masked on access
+    size_t ringSize = 1;
+    while (ringSize < size)
+        ringSize <<= 1;
+
+    _readPos = 0;
+    _writeCache = 0;
+    _writePos = 0;
+    _readCache = 0;
+    _data.resize(ringSize);
+    _mask = ringSize - 1;
+    _capacity = size;
+}
+
+template <typename T>
+bool SPSCQueue<T>::_fetchWritePos(const size_t readPos)
+{
+    _writeCache = _writePos.load(std::memory_order_acquire);
+    return readPos != _writeCache;
+}
+
+template <typename T>
+bool SPSCQueue<T>::pop(T& result)
+{
+    LB_TS_SCOPED(_reader);
+    const size_t readPos = _readPos.load(std::memory_order_relaxed);
+    if (readPos == _writeCache && !_fetchWritePos(readPos))
+        return false;
+
+    result = _data[readPos & _mask];
+    _readPos.store(readPos + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::getFront(T& result)
+{
+    LB_TS_SCOPED(_reader);
+    const size_t readPos = _readPos.load(std::memory_order_relaxed);
+    if (readPos == _writeCache && !_fetchWritePos(readPos))
+        return false;
+
+    result = _data[readPos & _mask];
+    return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::push(const T& element)
+{
+    LB_TS_SCOPED(_writer);
+    const size_t writePos = _writePos.load(std::memory_order_relaxed);
+    if (writePos - _readCache >= _capacity)
+    {
+        _readCache = _readPos.load(std::memory_order_acquire);
+        if (writePos - _readCache >= _capacity)
+            return false;
+    }
+
+    _data[writePos & _mask] = element;
+    _writePos.store(writePos + 1, std::memory_order_release);
+    return true;
+}
+}
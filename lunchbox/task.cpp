@@ -0,0 +1,144 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "task.h"
+
+#include <mutex>
+
+namespace lunchbox
+{
+namespace
+{
+// Size classes of 64, 128, 256 and 512 bytes
+#define NCLASSES 4
+#define MIN_SHIFT 6
+#define MAX_SIZE (size_t(1) << (MIN_SHIFT + NCLASSES - 1))
+#define BATCH 32 // blocks moved between a thread and the depot at once
+
+struct Block
+{
+    Block* next;
+};
+
+size_t _getClass(const size_t size)
+{
+    size_t index = 0;
+    while ((size_t(1) << (MIN_SHIFT + index)) < size)
+        ++index;
+    return index;
+}
+
+// Global free lists, shared by all threads. Never destroyed, since thread-local
+// caches of threads joined during static destruction still flush into it.
+struct Depot
+{
+    std::mutex mutex;
+    Block* lists[NCLASSES] = {};
+};
+
+Depot& _getDepot()
+{
+    static Depot* depot = new Depot;
+    return *depot;
+}
+
+// Per-thread free lists, refilled from and flushed to the depot in batches
+struct Cache
+{
+    Block* lists[NCLASSES] = {};
+    size_t sizes[NCLASSES] = {};
+
+    ~Cache()
+    {
+        for (size_t i = 0; i < NCLASSES; ++i)
+            flush(i, sizes[i]);
+    }
+
+    void* allocate(const size_t index)
+    {
+        if (!lists[index])
+            refill(index);
+
+        Block* block = lists[index];
+        if (!block)
+            return ::operator new(size_t(1) << (MIN_SHIFT + index));
+
+        lists[index] = block->next;
+        --sizes[index];
+        return block;
+    }
+
+    void free(void* ptr, const size_t index)
+    {
+        Block* block = static_cast<Block*>(ptr);
+        block->next = lists[index];
+        lists[index] = block;
+        if (++sizes[index] > 2 * BATCH)
+            flush(index, BATCH);
+    }
+
+    void refill(const size_t index)
+    {
+        Depot& depot = _getDepot();
+        std::unique_lock<std::mutex> lock(depot.mutex);
+        for (size_t i = 0; i < BATCH && depot.lists[index]; ++i)
+        {
+            Block* block = depot.lists[index];
+            depot.lists[index] = block->next;
+            block->next = lists[index];
+            lists[index] = block;
+            ++sizes[index];
+        }
+    }
+
+    void flush(const size_t index, size_t num)
+    {
+        if (num == 0)
+            return;
+
+        Block* first = lists[index];
+        Block* last = first;
+        sizes[index] -= num;
+        while (--num > 0)
+            last = last->next;
+        lists[index] = last->next;
+
+        Depot& depot = _getDepot();
+        std::unique_lock<std::mutex> lock(depot.mutex);
+        last->next = depot.lists[index];
+        depot.lists[index] = first;
+    }
+};
+
+thread_local Cache _cache;
+}
+
+void* allocateTaskMemory(const size_t size)
+{
+    if (size > MAX_SIZE)
+        return ::operator new(size);
+    return _cache.allocate(_getClass(size));
+}
+
+void freeTaskMemory(void* ptr, const size_t size)
+{
+    if (size > MAX_SIZE)
+        ::operator delete(ptr);
+    else
+        _cache.free(ptr, _getClass(size));
+}
+}
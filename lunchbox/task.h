@@ -0,0 +1,257 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_TASK_H
+#define LUNCHBOX_TASK_H
+
+#include <lunchbox/api.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lunchbox
+{
+/**
+ * Allocate memory from the task memory pool.
+ *
+ * Small sizes are served from thread-local free lists, which are refilled from
+ * and flushed to a global depot in batches. Larger sizes use operator new.
+ * Memory may be freed from any thread.
+ *
+ * @param size the number of bytes to allocate.
+ * @return the allocated memory, aligned for any fundamental type.
+ * @version 1.18
+ */
+LUNCHBOX_API void* allocateTaskMemory(size_t size);
+
+/**
+ * Free memory allocated with allocateTaskMemory().
+ *
+ * @param ptr the memory to free.
+ * @param size the size passed to allocateTaskMemory().
+ * @version 1.18
+ */
+LUNCHBOX_API void freeTaskMemory(void* ptr, size_t size);
+
+/**
+ * An STL allocator using the task memory pool.
+ *
+ * Used for the shared states of the futures returned by ThreadPool::post().
+ */
+template <typename T>
+class TaskAllocator
+{
+public:
+    typedef T value_type;
+
+    TaskAllocator() {}
+    template <typename U>
+    TaskAllocator(const TaskAllocator<U>&)
+    {
+    }
+
+    T* allocate(const size_t n)
+    {
+        return static_cast<T*>(allocateTaskMemory(n * sizeof(T)));
+    }
+    void deallocate(T* ptr, const size_t n)
+    {
+        freeTaskMemory(ptr, n * sizeof(T));
+    }
+    template <typename U>
+    bool operator==(const TaskAllocator<U>&) const
+    {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const TaskAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+/**
+ * A move-only callable taking no arguments and returning void.
+ *
+ * Replaces std::function< void() > for the ThreadPool. Callables up to
+ * INLINE_SIZE bytes with a non-throwing move constructor are stored inside the
+ * task itself, larger ones in the task memory pool. Constructing, moving and
+ * executing a small task therefore does not allocate memory.
+ */
+class Task
+{
+public:
+    /** The maximum size of callables stored inline. @version 1.18 */
+    static const size_t INLINE_SIZE = 7 * sizeof(void*);
+
+    /** Construct an empty task. @version 1.18 */
+    Task()
+        : _ops(nullptr)
+    {
+    }
+
+    /** Construct a task executing the given callable. @version 1.18 */
+    template <typename F, typename = typename std::enable_if<!std::is_same<
+                              typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& function)
+        : _ops(nullptr)
+    {
+        _construct<typename std::decay<F>::type>(std::forward<F>(function));
+    }
+
+    /** Move-construct a task. @version 1.18 */
+    Task(Task&& from) noexcept
+        : _ops(from._ops)
+    {
+        if (_ops)
+        {
+            _ops->move(&_storage, &from._storage);
+            from._ops = nullptr;
+        }
+    }
+
+    /** Destruct this task. @version 1.18 */
+    ~Task() { _reset(); }
+
+    /** Move-assign a task. @version 1.18 */
+    Task& operator=(Task&& from) noexcept
+    {
+        if (this == &from)
+            return *this;
+        _reset();
+        _ops = from._ops;
+        if (_ops)
+        {
+            _ops->move(&_storage, &from._storage);
+            from._ops = nullptr;
+        }
+        return *this;
+    }
+
+    /** Reset this task to empty. @version 1.18 */
+    Task& operator=(std::nullptr_t)
+    {
+        _reset();
+        return *this;
+    }
+
+    /** @return true if this task has a callable. @version 1.18 */
+    explicit operator bool() const { return _ops != nullptr; }
+
+    /** Execute the callable. @version 1.18 */
+    void operator()() { _ops->invoke(&_storage); }
+
+private:
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    struct Ops
+    {
+        void (*invoke)(void*);
+        void (*move)(void*, void*); // to, from; destroys from
+        void (*destroy)(void*);
+    };
+
+    typedef std::aligned_storage<INLINE_SIZE, alignof(void*)>::type Storage;
+    Storage _storage;
+    const Ops* _ops;
+
+    void _reset()
+    {
+        if (_ops)
+        {
+            _ops->destroy(&_storage);
+            _ops = nullptr;
+        }
+    }
+
+    template <typename F>
+    struct Inline
+    {
+        static constexpr bool value =
+            sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(Storage) &&
+            std::is_nothrow_move_constructible<F>::value;
+    };
+
+    template <typename F, typename A>
+    typename std::enable_if<Inline<F>::value>::type _construct(A&& function)
+    {
+        static const Ops ops = {&_invokeInline<F>, &_moveInline<F>,
+                                &_destroyInline<F>};
+        new (&_storage) F(std::forward<A>(function));
+        _ops = &ops;
+    }
+
+    template <typename F, typename A>
+    typename std::enable_if<!Inline<F>::value>::type _construct(A&& function)
+    {
+        static const Ops ops = {&_invokeHeap<F>, &_moveHeap,
+                                &_destroyHeap<F>};
+        void* memory = allocateTaskMemory(sizeof(F));
+        try
+        {
+            *reinterpret_cast<F**>(&_storage) =
+                new (memory) F(std::forward<A>(function));
+        }
+        catch (...)
+        {
+            freeTaskMemory(memory, sizeof(F));
+            throw;
+        }
+        _ops = &ops;
+    }
+
+    template <typename F>
+    static void _invokeInline(void* storage)
+    {
+        (*static_cast<F*>(storage))();
+    }
+    template <typename F>
+    static void _moveInline(void* to, void* from)
+    {
+        F* function = static_cast<F*>(from);
+        new (to) F(std::move(*function));
+        function->~F();
+    }
+    template <typename F>
+    static void _destroyInline(void* storage)
+    {
+        static_cast<F*>(storage)->~F();
+    }
+
+    template <typename F>
+    static void _invokeHeap(void* storage)
+    {
+        (**static_cast<F**>(storage))();
+    }
+    static void _moveHeap(void* to, void* from)
+    {
+        *static_cast<void**>(to) = *static_cast<void**>(from);
+    }
+    template <typename F>
+    static void _destroyHeap(void* storage)
+    {
+        F* function = *static_cast<F**>(storage);
+        function->~F();
+        freeTaskMemory(function, sizeof(F));
+    }
+};
+}
+
+#endif // LUNCHBOX_TASK_H
@@ -0,0 +1,261 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "taskGraph.h"
+
+#include "debug.h"
+#include "futex.h"
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+namespace lunchbox
+{
+namespace detail
+{
+namespace
+{
+struct Node
+{
+    Node(Task&& task_, const size_t dependencies, const bool any_)
+        : task(std::move(task_))
+        , remaining(dependencies)
+        , any(any_)
+        , failed(false)
+        , triggered(false)
+        , done(false)
+    {
+    }
+
+    Task task;
+    std::atomic<size_t> remaining; // uncompleted dependencies
+    const bool any;
+    std::atomic<bool> failed; // a dependency failed, or the task threw
+    std::atomic<bool> triggered;
+    bool done;                     // protected by TaskGraph::mutex
+    std::vector<Node*> successors; // protected by TaskGraph::mutex
+};
+}
+
+class TaskGraph
+{
+public:
+    explicit TaskGraph(lunchbox::ThreadPool& pool_)
+        : pool(pool_)
+        , running(false)
+        , pending(0)
+    {
+    }
+
+    lunchbox::ThreadPool& pool;
+
+    mutable std::mutex mutex;
+    std::deque<Node> nodes;   // deque: stable addresses on growth
+    std::vector<Node*> ready; // nodes without dependencies before run()
+    bool running;
+
+    std::atomic<size_t> pending; // added, not completed nodes
+    Futex idle;                  // epoch, incremented when pending drops to 0
+    std::exception_ptr exception;
+
+    void schedule(Node& node)
+    {
+        Node* ptr = &node;
+        pool.postDetached([this, ptr] { execute(*ptr); });
+    }
+
+    void execute(Node& node)
+    {
+        if (!node.failed)
+        {
+            try
+            {
+                node.task();
+            }
+            catch (...)
+            {
+                node.failed = true;
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        }
+        node.task = nullptr;
+        complete(node);
+    }
+
+    void complete(Node& node)
+    {
+        std::vector<Node*> successors;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            node.done = true;
+            successors.swap(node.successors);
+        }
+
+        for (Node* successor : successors)
+            satisfy(*successor, node.failed);
+
+        // Once pending drops to zero, wait() may return and the graph may be
+        // destroyed. This is the last access, the waiter synchronizes on the
+        // mutex before returning.
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--pending == 0)
+        {
+            ++idle;
+            idle.wakeAll();
+        }
+    }
+
+    // A dependency of the given node completed
+    void satisfy(Node& node, const bool failed)
+    {
+        if (node.any)
+        {
+            if (!failed && !node.triggered.exchange(true))
+            {
+                schedule(node);
+                return;
+            }
+            if (--node.remaining == 0 && !node.triggered.exchange(true))
+            {
+                node.failed = true; // all dependencies failed
+                complete(node);
+            }
+            return;
+        }
+
+        if (failed)
+            node.failed = true;
+        if (--node.remaining == 0)
+        {
+            if (node.failed)
+                complete(node);
+            else
+                schedule(node);
+        }
+    }
+};
+}
+
+TaskGraph::TaskGraph(ThreadPool& pool)
+    : _impl(new detail::TaskGraph(pool))
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+    }
+    delete _impl;
+}
+
+TaskGraph::Node TaskGraph::_add(Task&& task, const Node* dependencies,
+                                const size_t size, const bool any)
+{
+    std::unique_lock<std::mutex> lock(_impl->mutex);
+    const Node index = _impl->nodes.size();
+    _impl->nodes.emplace_back(std::move(task), size, any);
+    detail::Node& node = _impl->nodes.back();
+    ++_impl->pending;
+
+    // Completed dependencies are applied after releasing the lock, since they
+    // may complete this node recursively
+    std::vector<bool> completed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        LBASSERTINFO(dependencies[i] < index, "Unknown dependency");
+        detail::Node& dependency = _impl->nodes[dependencies[i]];
+        if (dependency.done)
+            completed.push_back(dependency.failed);
+        else
+            dependency.successors.push_back(&node);
+    }
+
+    if (size == 0)
+    {
+        if (_impl->running)
+        {
+            lock.unlock();
+            _impl->schedule(node);
+        }
+        else
+            _impl->ready.push_back(&node);
+        return index;
+    }
+
+    lock.unlock();
+    for (const bool failed : completed)
+        _impl->satisfy(node, failed);
+    return index;
+}
+
+void TaskGraph::run()
+{
+    std::vector<detail::Node*> ready;
+    {
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        if (_impl->running)
+            return;
+        _impl->running = true;
+        ready.swap(_impl->ready);
+    }
+
+    for (detail::Node* node : ready)
+        _impl->schedule(*node);
+}
+
+void TaskGraph::wait()
+{
+    run();
+    for (;;)
+    {
+        const uint32_t epoch = _impl->idle;
+        if (_impl->pending == 0)
+            break;
+        _impl->idle.wait(epoch);
+    }
+
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        exception = _impl->exception;
+        _impl->exception = nullptr;
+    }
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+bool TaskGraph::isDone(const Node node) const
+{
+    std::unique_lock<std::mutex> lock(_impl->mutex);
+    return node < _impl->nodes.size() && _impl->nodes[node].done;
+}
+
+size_t TaskGraph::getSize() const
+{
+    std::unique_lock<std::mutex> lock(_impl->mutex);
+    return _impl->nodes.size();
+}
+}
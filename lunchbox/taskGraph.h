@@ -0,0 +1,151 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LUNCHBOX_TASKGRAPH_H
+#define LUNCHBOX_TASKGRAPH_H
+
+#include <lunchbox/api.h>
+#include <lunchbox/task.h>       // used inline
+#include <lunchbox/threadPool.h> // default argument
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace lunchbox
+{
+namespace detail
+{
+class TaskGraph;
+}
+
+/**
+ * Executes tasks with dependencies on a ThreadPool.
+ *
+ * Each task is a node in a directed acyclic graph. A node is posted to the
+ * pool by the thread completing its last dependency, without any thread
+ * blocking on the dependencies. Nodes may be added before and after run():
+ * nodes added to a running graph whose dependencies have already completed are
+ * posted immediately, which allows a graph to be used as a continuation
+ * mechanism.
+ *
+ * If a task throws, its dependent nodes are not executed and complete as
+ * failed. A whenAny() node only fails if all its dependencies failed. wait()
+ * rethrows the first exception.
+ *
+ * All methods are thread-safe. The graph may not be destroyed from one of its
+ * own tasks.
+ *
+ * Example: @include tests/taskGraph.cpp
+ */
+class TaskGraph : public boost::noncopyable
+{
+public:
+    /** The handle of a node in the graph. */
+    typedef size_t Node;
+
+    /**
+     * Construct a new task graph.
+     *
+     * @param pool the thread pool executing the tasks.
+     * @version 1.18
+     */
+    LUNCHBOX_API explicit TaskGraph(
+        ThreadPool& pool = ThreadPool::getInstance());
+
+    /** Wait for all nodes and destruct the task graph. @version 1.18 */
+    LUNCHBOX_API ~TaskGraph();
+
+    /**
+     * Add a task without dependencies.
+     * @return the node of the task.
+     * @version 1.18
+     */
+    template <typename F>
+    Node add(F&& task)
+    {
+        return _add(Task(std::forward<F>(task)), nullptr, 0, false);
+    }
+
+    /**
+     * Add a task executed after the given node has completed.
+     * @return the node of the continuation.
+     * @version 1.18
+     */
+    template <typename F>
+    Node then(const Node dependency, F&& task)
+    {
+        return _add(Task(std::forward<F>(task)), &dependency, 1, false);
+    }
+
+    /**
+     * Add a task executed after all the given nodes have completed.
+     * @return the node of the task.
+     * @version 1.18
+     */
+    template <typename F>
+    Node whenAll(const std::vector<Node>& dependencies, F&& task)
+    {
+        return _add(Task(std::forward<F>(task)), dependencies.data(),
+                    dependencies.size(), false);
+    }
+
+    /**
+     * Add a task executed after the first of the given nodes has completed.
+     * @return the node of the task.
+     * @version 1.18
+     */
+    template <typename F>
+    Node whenAny(const std::vector<Node>& dependencies, F&& task)
+    {
+        return _add(Task(std::forward<F>(task)), dependencies.data(),
+                    dependencies.size(), true);
+    }
+
+    /**
+     * Start executing the graph.
+     *
+     * Posts all nodes without pending dependencies. Nodes added later are
+     * posted as soon as their dependencies are satisfied.
+     * @version 1.18
+     */
+    LUNCHBOX_API void run();
+
+    /**
+     * Wait until all nodes added so far have completed.
+     *
+     * Runs the graph if it is not yet running. Must not be called from a task
+     * of this graph.
+     * @throw the first exception thrown by a task of this graph.
+     * @version 1.18
+     */
+    LUNCHBOX_API void wait();
+
+    /** @return true if the given node has completed. @version 1.18 */
+    LUNCHBOX_API bool isDone(const Node node) const;
+
+    /** @return the number of nodes in the graph. @version 1.18 */
+    LUNCHBOX_API size_t getSize() const;
+
+private:
+    detail::TaskGraph* const _impl;
+
+    LUNCHBOX_API Node _add(Task&& task, const Node* dependencies,
+                           const size_t size, const bool any);
+};
+}
+
+#endif // LUNCHBOX_TASKGRAPH_H
@@ -16,62 +16,1254 @@
 
 #include "threadPool.h"
 
+#include "compiler.h"
+#include "debug.h"
+#include "file.h"
+#include "futex.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef LUNCHBOX_USE_HWLOC
+#include <hwloc.h>
+#endif
+
 namespace lunchbox
 {
+namespace detail
+{
+namespace
+{
+typedef std::vector<unsigned> CPUs;
+typedef std::vector<CPUs> Nodes;
+
+#if defined(__linux__) && !defined(LUNCHBOX_USE_HWLOC)
+// Parse a sysfs cpu list, e.g., "0-3,8-11"
+CPUs _parseCPUList(const std::string& list)
+{
+    CPUs cpus;
+    const char* pos = list.c_str();
+    while (*pos >= '0' && *pos <= '9')
+    {
+        char* end = nullptr;
+        const unsigned first = unsigned(std::strtoul(pos, &end, 10));
+        unsigned last = first;
+        if (*end == '-')
+            last = unsigned(std::strtoul(end + 1, &end, 10));
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+        pos = (*end == ',') ? end + 1 : end;
+    }
+    return cpus;
+}
+#endif
+
+// @return the CPUs of each NUMA node, ordered by node index
+Nodes _detectNodes()
+{
+    Nodes nodes;
+#ifdef LUNCHBOX_USE_HWLOC
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    hwloc_topology_load(topology);
+    const int numNodes = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+    for (int i = 0; i < numNodes; ++i)
+    {
+        const hwloc_obj_t node =
+            hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, i);
+        hwloc_bitmap_t cpuSet = hwloc_bitmap_alloc();
+        hwloc_bitmap_and(cpuSet, node->cpuset,
+                         hwloc_topology_get_allowed_cpuset(topology));
+
+        CPUs cpus;
+        unsigned cpu;
+        hwloc_bitmap_foreach_begin(cpu, cpuSet) cpus.push_back(cpu);
+        hwloc_bitmap_foreach_end();
+        hwloc_bitmap_free(cpuSet);
+        if (!cpus.empty())
+            nodes.push_back(cpus);
+    }
+    hwloc_topology_destroy(topology);
+#elif defined(__linux__)
+    const std::string path("/sys/devices/system/node/");
+    std::vector<unsigned> indices;
+    for (const std::string& name : searchDirectory(path, "node[0-9]+"))
+        indices.push_back(unsigned(std::strtoul(name.c_str() + 4, 0, 10)));
+    std::sort(indices.begin(), indices.end());
+
+    for (const unsigned index : indices)
+    {
+        std::ifstream file(path + "node" + std::to_string(index) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        const CPUs cpus = _parseCPUList(list);
+        if (!cpus.empty()) // memory-only nodes have no CPUs
+            nodes.push_back(cpus);
+    }
+#endif
+
+    if (nodes.empty())
+    {
+        // unknown topology: a single node with all CPUs
+        CPUs cpus(std::max(std::thread::hardware_concurrency(), 1u));
+        for (size_t i = 0; i < cpus.size(); ++i)
+            cpus[i] = unsigned(i);
+        nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+const Nodes& _getNodes()
+{
+    static const Nodes nodes = _detectNodes();
+    return nodes;
+}
+
+// Pin the calling thread to the given CPUs
+void _bind(const CPUs& cpus)
+{
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (const unsigned cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        LBWARN << "Error binding thread pool worker to CPUs" << std::endl;
+#elif defined(LUNCHBOX_USE_HWLOC)
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    hwloc_topology_load(topology);
+    hwloc_bitmap_t cpuSet = hwloc_bitmap_alloc();
+    for (const unsigned cpu : cpus)
+        hwloc_bitmap_set(cpuSet, cpu);
+    if (hwloc_set_cpubind(topology, cpuSet, HWLOC_CPUBIND_THREAD) != 0)
+        LBWARN << "Error binding thread pool worker to CPUs" << std::endl;
+    hwloc_bitmap_free(cpuSet);
+    hwloc_topology_destroy(topology);
+#else
+    LBVERB << "Thread pool worker pinning not implemented" << std::endl;
+#endif
+}
+
+typedef std::chrono::steady_clock SteadyClock;
+
+// A queued task
+struct Entry
+{
+    Task task;
+    SteadyClock::time_point queued;
+    SteadyClock::time_point deadline; // max() if none
+
+    // heap order, earliest deadline on top
+    bool operator<(const Entry& rhs) const { return deadline > rhs.deadline; }
+};
+
+// Growable ring buffer of tasks, does not allocate once it reached its
+// high-water mark, unlike std::deque which allocates a new node every few
+// pushes.
+class TaskQueue
+{
+public:
+    TaskQueue()
+        : _tasks(16)
+        , _first(0)
+        , _size(0)
+    {
+    }
+
+    bool empty() const { return _size == 0; }
+    const Entry& front() const { return _tasks[_first]; }
+    void push_back(Entry&& entry)
+    {
+        if (_size == _tasks.size())
+            _grow();
+        _tasks[(_first + _size) & (_tasks.size() - 1)] = std::move(entry);
+        ++_size;
+    }
+
+    Entry pop_front()
+    {
+        Entry entry = std::move(_tasks[_first]);
+        _first = (_first + 1) & (_tasks.size() - 1);
+        --_size;
+        return entry;
+    }
+
+private:
+    std::vector<Entry> _tasks; // power-of-two size
+    size_t _first;
+    size_t _size;
+
+    void _grow()
+    {
+        std::vector<Entry> tasks(_tasks.size() * 2);
+        for (size_t i = 0; i < _size; ++i)
+            tasks[i] = std::move(_tasks[(_first + i) & (_tasks.size() - 1)]);
+        _tasks.swap(tasks);
+        _first = 0;
+    }
+};
+
+const size_t HISTOGRAM_SIZE = lunchbox::ThreadPool::HISTOGRAM_SIZE;
+
+// @return the histogram bucket of the given time in nanoseconds
+size_t _getBucket(const uint64_t time)
+{
+    uint64_t us = time / 1000;
+    size_t bucket = 0;
+    while (us > 0 && bucket < HISTOGRAM_SIZE - 1)
+    {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// Increment a counter with a single writer, cheaper than fetch_add
+void _add(std::atomic<uint64_t>& counter, const uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+// Execution statistics, written by a single thread at a time
+struct Counters
+{
+    Counters()
+        : executed(0)
+        , steals(0)
+        , busyTime(0)
+    {
+        for (std::atomic<uint64_t>& bucket : histogram)
+            bucket = 0;
+    }
+
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> steals;
+    std::atomic<uint64_t> busyTime; // ns
+    std::atomic<uint64_t> histogram[HISTOGRAM_SIZE];
+
+    void record(const uint64_t time)
+    {
+        _add(executed, 1);
+        _add(busyTime, time);
+        _add(histogram[_getBucket(time)], 1);
+    }
+};
+
+// The tasks of one priority level of a worker. Tasks with a deadline are
+// executed first, in deadline order, then the others in posting order. The
+// statistics are only written with the worker mutex locked.
+struct Level
+{
+    Level()
+        : size(0)
+        , posted(0)
+        , started(0)
+        , waitTime(0)
+        , maxWaitTime(0)
+        , _edfOldest(SteadyClock::time_point::max())
+        , _edfOldestValid(true)
+    {
+        for (std::atomic<uint64_t>& bucket : waitHistogram)
+            bucket = 0;
+    }
+
+    TaskQueue fifo;
+    std::vector<Entry> edf; // heap, does not shrink
+
+    std::atomic<size_t> size;
+    std::atomic<uint64_t> posted;
+    std::atomic<uint64_t> started;
+    std::atomic<uint64_t> waitTime;    // ns, sum over started tasks
+    std::atomic<uint64_t> maxWaitTime; // ns
+    std::atomic<uint64_t> waitHistogram[HISTOGRAM_SIZE];
+
+    bool empty() const { return fifo.empty() && edf.empty(); }
+
+    // @return the queue time of the task which waits the longest
+    SteadyClock::time_point oldest() const
+    {
+        if (edf.empty())
+            return fifo.front().queued;
+        if (!_edfOldestValid)
+        {
+            _edfOldest =
+                std::min_element(edf.begin(), edf.end(), _isOlder)->queued;
+            _edfOldestValid = true;
+        }
+        if (fifo.empty())
+            return _edfOldest;
+        return std::min(fifo.front().queued, _edfOldest);
+    }
+
+    void push(Entry&& entry)
+    {
+        if (entry.deadline == SteadyClock::time_point::max())
+            fifo.push_back(std::move(entry));
+        else
+        {
+            if (edf.empty())
+            {
+                _edfOldest = entry.queued;
+                _edfOldestValid = true;
+            }
+            else if (_edfOldestValid && entry.queued < _edfOldest)
+                _edfOldest = entry.queued;
+            edf.push_back(std::move(entry));
+            std::push_heap(edf.begin(), edf.end());
+        }
+        size.store(size.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+        _add(posted, 1);
+    }
+
+    // @param oldest take the oldest instead of the most urgent task
+    Entry pop(const bool oldest)
+    {
+        size.store(size.load(std::memory_order_relaxed) - 1,
+                   std::memory_order_relaxed);
+        if (edf.empty())
+            return fifo.pop_front();
+
+        if (oldest)
+        {
+            // The deadline order does not follow the queue order, the
+            // oldest entry may be anywhere in the heap
+            const auto i = std::min_element(edf.begin(), edf.end(), _isOlder);
+            if (!fifo.empty() && fifo.front().queued <= i->queued)
+                return fifo.pop_front();
+
+            Entry entry = std::move(*i);
+            *i = std::move(edf.back());
+            edf.pop_back();
+            std::make_heap(edf.begin(), edf.end());
+            _edfOldestValid = false;
+            return entry;
+        }
+
+        std::pop_heap(edf.begin(), edf.end());
+        Entry entry = std::move(edf.back());
+        edf.pop_back();
+        if (entry.queued <= _edfOldest)
+            _edfOldestValid = false;
+        return entry;
+    }
+
+    void record(const uint64_t wait)
+    {
+        _add(started, 1);
+        _add(waitTime, wait);
+        _add(waitHistogram[_getBucket(wait)], 1);
+        if (wait > maxWaitTime.load(std::memory_order_relaxed))
+            maxWaitTime.store(wait, std::memory_order_relaxed);
+    }
+
+private:
+    // Queue time of the oldest deadline task, recomputed lazily once that
+    // task was taken
+    mutable SteadyClock::time_point _edfOldest;
+    mutable bool _edfOldestValid;
+
+    static bool _isOlder(const Entry& a, const Entry& b)
+    {
+        return a.queued < b.queued;
+    }
+};
+
+const size_t NUM_LEVELS = lunchbox::ThreadPool::NUM_PRIORITIES;
+
+#define MAXTHREADS 1024
+const size_t MIN_TIMER_COMPACTION = 64; // timer heap size
+
+// One worker slot. Slots are created on demand and live as long as the pool,
+// their threads come and go with resize() and the idle timeout. Padded to keep
+// the queue lock of one worker off the cache lines of others.
+struct Worker
+{
+    explicit Worker(const int32_t node_)
+        : node(node_)
+        , since(0)
+        , busyAtStart(0)
+        , active(false)
+        , retire(false)
+        , exited(true)
+    {
+    }
+
+    char pad0[LB_CACHELINE_SIZE];
+    const int32_t node; // pinned to this NUMA node, or -1
+    std::mutex mutex;
+    Level levels[NUM_LEVELS];
+    Counters counters; // written by the worker thread
+
+    // busy ratio of the current thread, set on spawn
+    std::atomic<int64_t> since; // ns, steady clock time of the thread start
+    std::atomic<uint64_t> busyAtStart;
+
+    std::atomic<bool> active; // thread running and accepting external posts
+    std::atomic<bool> retire; // thread exits once its queue is empty
+    std::atomic<bool> exited; // thread detached or joinable without blocking
+    std::thread thread;       // protected by ThreadPool::control
+    char pad1[LB_CACHELINE_SIZE];
+};
+
+// The pool and worker of the calling thread, if it is a worker
+thread_local ThreadPool* _currentPool = nullptr;
+thread_local Worker* _currentWorker = nullptr;
+}
+
+// A delayed or periodic task, shared by the timer heap, the posted task and
+// the ThreadPool::Timer handles
+class Timer
+{
+public:
+    enum State
+    {
+        SCHEDULED,
+        RUNNING,
+        CANCELLED,
+        DONE
+    };
+
+    Timer(Task&& task_, const SteadyClock::time_point due_,
+          const uint32_t period_)
+        : task(std::move(task_))
+        , due(due_)
+        , period(period_)
+        , state(SCHEDULED)
+    {
+    }
+
+    /**
+     * Cancel future executions. The task is released right away, or by the
+     * execution of a periodic task in progress.
+     */
+    bool cancel()
+    {
+        State current = state.load();
+        for (;;)
+        {
+            switch (current)
+            {
+            case SCHEDULED:
+                if (!state.compare_exchange_weak(current, CANCELLED))
+                    continue;
+                task = nullptr; // _fire() does not touch it anymore
+                return true;
+            case RUNNING:
+                if (period.count() == 0)
+                    return false;
+                if (!state.compare_exchange_weak(current, CANCELLED))
+                    continue;
+                return true;
+            default:
+                return false;
+            }
+        }
+    }
+
+    bool isScheduled() const
+    {
+        const State current = state.load();
+        return current == SCHEDULED ||
+               (current == RUNNING && period.count() > 0);
+    }
+
+    Task task;
+    SteadyClock::time_point due; // protected by ThreadPool::timerMutex
+    const std::chrono::milliseconds period; // 0 for one-shot timers
+    std::atomic<State> state;
+};
+
+namespace
+{
+typedef std::shared_ptr<Timer> TimerPtr;
+
+// heap order, earliest due time on top
+bool _isLater(const TimerPtr& lhs, const TimerPtr& rhs)
+{
+    return lhs->due > rhs->due;
+}
+}
+
+class ThreadPool
+{
+public:
+    ThreadPool(const size_t size_, const int32_t placement_)
+        : placement(placement_)
+        , high(0)
+        , size(std::max(size_, size_t(1))) // tasks need a worker to run
+        , running(0)
+        , idleTimeout(LB_TIMEOUT_INDEFINITE)
+        , starvationTimeout(100)
+        , pending(0)
+        , maxPending(0)
+        , unfinished(0)
+        , next(0)
+        , sleeping(0)
+        , stop(false)
+        , idleWaiters(0)
+        , timerStop(false)
+        , timerCompaction(MIN_TIMER_COMPACTION)
+    {
+        LBASSERTINFO(size <= MAXTHREADS, size << " > " << MAXTHREADS);
+        LBASSERTINFO(placement >= lunchbox::ThreadPool::UNPINNED &&
+                         placement < int32_t(_getNodes().size()),
+                     "Unknown NUMA node " << placement);
+        std::unique_lock<std::mutex> lock(control);
+        while (running < size && _spawn())
+            /* nop */;
+    }
+
+    ~ThreadPool()
+    {
+        // timers not yet due are cancelled, periodic timers stop
+        {
+            std::unique_lock<std::mutex> lock(timerMutex);
+            timerStop = true;
+            timerCondition.notify_one();
+        }
+        if (timerThread.joinable())
+            timerThread.join();
+        for (const TimerPtr& timer : timers)
+            timer->cancel();
+        timers.clear();
+
+        drain();
+        {
+            // under control: exiting workers are joined, not detached
+            std::unique_lock<std::mutex> controlLock(control);
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            stop = true;
+            condition.notify_all();
+        }
+
+        // No more tasks are running which could spawn threads concurrently
+        for (size_t i = 0; i < high; ++i)
+            if (slots[i]->thread.joinable())
+                slots[i]->thread.join();
+    }
+
+    void post(Task&& task, int32_t node, const size_t priority,
+              const uint32_t deadline)
+    {
+        LBASSERT(priority < NUM_LEVELS);
+        const SteadyClock::time_point now = SteadyClock::now();
+        Entry entry{std::move(task), now,
+                    deadline == LB_TIMEOUT_INDEFINITE
+                        ? SteadyClock::time_point::max()
+                        : now + std::chrono::milliseconds(deadline)};
+
+        // node hints only matter if the workers are spread over nodes
+        if (placement != lunchbox::ThreadPool::ALL_NODES)
+            node = -1;
+
+        ++unfinished;
+        Worker& worker = _currentPool == this && (node < 0 ||
+                                                  _currentWorker->node == node)
+                             ? *_currentWorker
+                             : _select(node);
+        // Counted before the push under the worker lock, so the task can't be
+        // taken and uncounted first. seq_cst pairs with the sleeping
+        // increment in _wait().
+        size_t queued;
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            queued = ++pending;
+            try
+            {
+                worker.levels[priority].push(std::move(entry));
+            }
+            catch (...)
+            {
+                --pending;
+                if (--unfinished == 0 && idleWaiters.load() > 0)
+                {
+                    ++idle;
+                    idle.wakeAll();
+                }
+                throw;
+            }
+        }
+
+        size_t maximum = maxPending.load(std::memory_order_relaxed);
+        while (queued > maximum &&
+               !maxPending.compare_exchange_weak(maximum, queued,
+                                                 std::memory_order_relaxed))
+        {
+        }
+        if (sleeping.load() > 0)
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            condition.notify_one();
+        }
+        else if (running.load() < size.load())
+        {
+            // all workers are busy, and some were shut down on idle timeout
+            std::unique_lock<std::mutex> lock(control);
+            if (running < size)
+                _spawn();
+        }
+    }
+
+    void resize(const size_t newSize)
+    {
+        LBASSERTINFO(newSize <= MAXTHREADS, newSize << " > " << MAXTHREADS);
+        {
+            std::unique_lock<std::mutex> lock(control);
+            size = std::max(newSize, size_t(1));
+            while (running < size && _spawn())
+                /* nop */;
+
+            for (size_t i = high; i > 0 && running > size; --i)
+            {
+                Worker& worker = *slots[i - 1];
+                if (worker.active)
+                    _retire(worker);
+            }
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        condition.notify_all();
+    }
+
+    bool waitIdle(const uint32_t timeout)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        ++idleWaiters;
+        bool result = true;
+        for (;;)
+        {
+            const uint32_t epoch = idle.load();
+            if (unfinished.load() == 0)
+                break;
+
+            uint32_t remaining = LB_TIMEOUT_INDEFINITE;
+            if (timeout != LB_TIMEOUT_INDEFINITE)
+            {
+                const auto elapsed =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+                if (elapsed >= timeout)
+                {
+                    result = false;
+                    break;
+                }
+                remaining = timeout - uint32_t(elapsed);
+            }
+            idle.wait(epoch, remaining);
+        }
+        --idleWaiters;
+        return result;
+    }
+
+    void drain()
+    {
+        Task task;
+        SteadyClock::time_point start;
+        while (_steal(nullptr, task, start))
+            _execute(task, start, nullptr);
+        waitIdle(LB_TIMEOUT_INDEFINITE);
+    }
+
+    // UNPINNED, ALL_NODES or the node index all workers are pinned to
+    const int32_t placement;
+    std::unique_ptr<Worker> slots[MAXTHREADS];
+    std::atomic<size_t> high; // number of created slots
+
+    std::mutex control; // protects thread creation and retirement
+    std::atomic<size_t> size;
+    std::atomic<size_t> running;
+    std::atomic<uint32_t> idleTimeout;
+    std::atomic<uint32_t> starvationTimeout;
+
+    std::atomic<size_t> pending;    // queued, not yet started tasks
+    std::atomic<size_t> maxPending; // high-water mark of pending
+    std::atomic<size_t> unfinished; // posted, not yet finished tasks
+    std::atomic<size_t> next;       // round-robin worker for external posts
+
+    std::mutex sleepMutex;
+    std::condition_variable condition;
+    std::atomic<size_t> sleeping;
+    std::atomic<bool> stop;
+
+    Futex idle; // epoch, incremented when unfinished drops to zero
+    std::atomic<size_t> idleWaiters;
+
+    std::mutex externalMutex;
+    Counters external; // tasks executed by drain()
+
+    std::mutex timerMutex;
+    std::condition_variable timerCondition;
+    std::vector<TimerPtr> timers; // heap
+    std::thread timerThread;      // started on first use
+    bool timerStop;
+    size_t timerCompaction; // heap size removing cancelled timers
+
+    TimerPtr postTimer(Task&& task, const uint32_t delay,
+                       const uint32_t period)
+    {
+        TimerPtr timer = std::allocate_shared<Timer>(
+            TaskAllocator<Timer>(), std::move(task),
+            SteadyClock::now() + std::chrono::milliseconds(delay), period);
+        _schedule(timer);
+        return timer;
+    }
+
+private:
+    void _work(Worker& worker)
+    {
+        _currentPool = this;
+        _currentWorker = &worker;
+        if (worker.node >= 0)
+            _bind(_getNodes()[worker.node]);
+
+        Task task;
+        SteadyClock::time_point start;
+        for (;;)
+        {
+            if (_take(worker, task, start))
+                _execute(task, start, &worker);
+            else if (worker.retire)
+                break;
+            else if (_steal(&worker, task, start))
+            {
+                _add(worker.counters.steals, 1);
+                _execute(task, start, &worker);
+            }
+            else if (stop && pending == 0)
+                break;
+            else
+                _wait(worker);
+        }
+
+        // Retired workers detach, which releases their stack as soon as they
+        // exit. The destructor joins the workers exiting on stop.
+        std::unique_lock<std::mutex> lock(control);
+        if (!stop)
+            worker.thread.detach();
+        worker.exited = true;
+    }
+
+    // @param worker the executing worker, nullptr for drain()
+    void _execute(Task& task, const SteadyClock::time_point start,
+                  Worker* worker)
+    {
+        task();
+        task = nullptr;
+
+        // recorded before waitIdle() may return
+        const uint64_t time =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                SteadyClock::now() - start)
+                .count();
+        if (worker)
+            worker->counters.record(time);
+        else
+        {
+            std::lock_guard<std::mutex> lock(externalMutex);
+            external.record(time);
+        }
+
+        if (--unfinished == 0 && idleWaiters.load() > 0)
+        {
+            ++idle;
+            idle.wakeAll();
+        }
+    }
+
+    // Called with control locked. @return false if all slots are in use.
+    bool _spawn()
+    {
+        Worker* worker = nullptr;
+        for (size_t i = 0; i < high && !worker; ++i)
+        {
+            if (slots[i]->exited)
+                worker = slots[i].get();
+        }
+
+        if (!worker)
+        {
+            if (high == MAXTHREADS)
+                return false;
+            slots[high].reset(new Worker(_getSlotNode(high)));
+            worker = slots[high].get();
+            ++high; // publishes the slot to _select() and _steal()
+        }
+
+        if (worker->thread.joinable())
+            worker->thread.join();
+        worker->retire = false;
+        worker->exited = false;
+        worker->active = true;
+        worker->since = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            SteadyClock::now().time_since_epoch())
+                            .count();
+        worker->busyAtStart = worker->counters.busyTime.load();
+        ++running;
+        worker->thread = std::thread([this, worker] { _work(*worker); });
+        return true;
+    }
+
+    // Called with control locked
+    void _retire(Worker& worker)
+    {
+        worker.active = false;
+        worker.retire = true;
+        --running;
+    }
+
+    // Slots are assigned round-robin to nodes, which keeps the running
+    // workers evenly spread when shrinking from the highest slot.
+    int32_t _getSlotNode(const size_t slot) const
+    {
+        if (placement == lunchbox::ThreadPool::ALL_NODES)
+            return int32_t(slot % _getNodes().size());
+        return std::max(placement, -1);
+    }
+
+    // Select a running worker on the given node, or on any node if node < 0
+    // or no worker of the node is running
+    Worker& _select(const int32_t node)
+    {
+        const size_t num = high.load();
+        LBASSERT(num > 0);
+        for (size_t i = 0; i < num; ++i)
+        {
+            Worker& worker = *slots[next++ % num];
+            if (worker.active && (node < 0 || worker.node == node))
+                return worker;
+        }
+        if (node >= 0)
+            return _select(-1);
+        // No running worker, the task is stolen by the next spawned one
+        return *slots[0];
+    }
+
+    bool _take(Worker& worker, Task& task, SteadyClock::time_point& start)
+    {
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        size_t priority = 0;
+        while (priority < NUM_LEVELS && worker.levels[priority].empty())
+            ++priority;
+        if (priority == NUM_LEVELS)
+            return false;
+
+        // Starvation protection: a less urgent task waiting for longer than
+        // the starvation timeout is taken first, oldest task first
+        const SteadyClock::time_point now = SteadyClock::now();
+        const uint32_t timeout = starvationTimeout.load();
+        bool starving = false;
+        if (timeout != LB_TIMEOUT_INDEFINITE)
+        {
+            const auto limit = now - std::chrono::milliseconds(timeout);
+            for (size_t i = NUM_LEVELS; i > priority + 1; --i)
+            {
+                const Level& level = worker.levels[i - 1];
+                if (!level.empty() && level.oldest() <= limit)
+                {
+                    priority = i - 1;
+                    starving = true;
+                    break;
+                }
+            }
+        }
+
+        Level& level = worker.levels[priority];
+        Entry entry = level.pop(starving);
+        level.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         now - entry.queued)
+                         .count());
+        task = std::move(entry.task);
+        start = now;
+        --pending;
+        return true;
+    }
+
+    // Steal from any worker but the given one, which may be nullptr. Workers
+    // of the thief's node are tried first, tasks of other nodes are only
+    // taken to avoid idling.
+    bool _steal(const Worker* thief, Task& task,
+                SteadyClock::time_point& start)
+    {
+        const size_t num = high.load();
+        const size_t first = next.load(std::memory_order_relaxed);
+        const int32_t node = thief ? thief->node : -1;
+        const bool local = placement == lunchbox::ThreadPool::ALL_NODES &&
+                           node >= 0 && _getNodes().size() > 1;
+        for (size_t pass = local ? 0 : 1; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < num; ++i)
+            {
+                Worker& victim = *slots[(first + i) % num];
+                if (&victim == thief || (pass == 0 && victim.node != node))
+                    continue;
+                if (_take(victim, task, start))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    void _schedule(const TimerPtr& timer)
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        if (timerStop)
+        {
+            timer->state = Timer::CANCELLED;
+            return;
+        }
+        if (!timerThread.joinable())
+            timerThread = std::thread([this] { _runTimers(); });
+
+        // Cancelled timers stay in the heap until they are due, unless they
+        // make up half of it. Amortized over the pushes since the last
+        // compaction, which keeps the heap at most twice the live timers.
+        if (timers.size() >= timerCompaction)
+        {
+            timers.erase(std::remove_if(timers.begin(), timers.end(),
+                                        [](const TimerPtr& entry) {
+                                            return entry->state ==
+                                                   Timer::CANCELLED;
+                                        }),
+                         timers.end());
+            std::make_heap(timers.begin(), timers.end(), _isLater);
+            timerCompaction =
+                std::max(MIN_TIMER_COMPACTION, timers.size() * 2);
+        }
+
+        timers.push_back(timer);
+        std::push_heap(timers.begin(), timers.end(), _isLater);
+        if (timers.front() == timer) // new earliest timer
+            timerCondition.notify_one();
+    }
+
+    // The timer thread, posts due timers to the pool
+    void _runTimers()
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        while (!timerStop)
+        {
+            if (timers.empty())
+            {
+                timerCondition.wait(lock);
+                continue;
+            }
+
+            TimerPtr timer = timers.front();
+            if (timer->state == Timer::CANCELLED)
+            {
+                std::pop_heap(timers.begin(), timers.end(), _isLater);
+                timers.pop_back();
+                continue;
+            }
+            if (SteadyClock::now() < timer->due)
+            {
+                timerCondition.wait_until(lock, timer->due);
+                continue;
+            }
+
+            std::pop_heap(timers.begin(), timers.end(), _isLater);
+            timers.pop_back();
+            lock.unlock();
+            post(Task([this, timer] { _fire(timer); }), -1,
+                 lunchbox::ThreadPool::PRIORITY_NORMAL, LB_TIMEOUT_INDEFINITE);
+            lock.lock();
+        }
+    }
+
+    void _fire(const TimerPtr& timer)
+    {
+        if (timer->period.count() == 0)
+        {
+            Timer::State expected = Timer::SCHEDULED;
+            if (!timer->state.compare_exchange_strong(expected,
+                                                      Timer::RUNNING))
+            {
+                return; // cancelled
+            }
+            timer->task();
+            timer->task = nullptr;
+            timer->state = Timer::DONE;
+            return;
+        }
+
+        Timer::State expected = Timer::SCHEDULED;
+        if (!timer->state.compare_exchange_strong(expected, Timer::RUNNING))
+            return; // cancelled
+        timer->task();
+        expected = Timer::RUNNING;
+        if (!timer->state.compare_exchange_strong(expected, Timer::SCHEDULED))
+        {
+            timer->task = nullptr; // cancelled during the execution
+            return;
+        }
+
+        // Fixed rate, executions do not overlap and missed ones are skipped
+        {
+            std::unique_lock<std::mutex> lock(timerMutex);
+            const SteadyClock::time_point now = SteadyClock::now();
+            timer->due += timer->period;
+            if (timer->due < now)
+                timer->due = now;
+        }
+        _schedule(timer);
+    }
+
+    void _wait(Worker& worker)
+    {
+        const uint32_t timeout = idleTimeout.load();
+        // a changed timeout wakes up the worker to restart the wait with it
+        const auto hasWork = [this, &worker, timeout] {
+            return stop || worker.retire || pending.load() > 0 ||
+                   idleTimeout.load() != timeout;
+        };
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        ++sleeping;
+        bool timedOut = false;
+        if (timeout == LB_TIMEOUT_INDEFINITE)
+            condition.wait(lock, hasWork);
+        else
+            timedOut = !condition.wait_for(lock,
+                                           std::chrono::milliseconds(timeout),
+                                           hasWork);
+        --sleeping;
+        lock.unlock();
+
+        if (!timedOut)
+            return;
+
+        std::unique_lock<std::mutex> controlLock(control);
+        if (worker.retire)
+            return;
+        _retire(worker);
+
+        // seq_cst pairs with post(): either the poster sees the decremented
+        // running count and spawns a thread, or we see its task and stay.
+        if (pending.load() > 0 && running < size)
+        {
+            worker.retire = false;
+            worker.active = true;
+            ++running;
+        }
+    }
+};
+}
+
 ThreadPool& ThreadPool::getInstance()
 {
-    static ThreadPool pool(std::thread::hardware_concurrency());
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
     return pool;
 }
 
 ThreadPool::ThreadPool(const size_t size)
-    : _stop(false)
+    : _impl(new detail::ThreadPool(size, UNPINNED))
+{
+}
+
+namespace
+{
+size_t _getDefaultSize(const int32_t node)
+{
+    const detail::Nodes& nodes = detail::_getNodes();
+    if (node >= 0 && size_t(node) < nodes.size())
+        return nodes[node].size();
+
+    size_t size = 0;
+    for (const detail::CPUs& cpus : nodes)
+        size += cpus.size();
+    return size;
+}
+}
+
+ThreadPool::ThreadPool(const size_t size, const int32_t node)
+    : _impl(new detail::ThreadPool(size ? size : _getDefaultSize(node), node))
 {
-    for (size_t i = 0; i < size; ++i)
-        _threads.emplace_back([this] { this->work(); });
+}
+
+size_t ThreadPool::getNumNodes()
+{
+    return detail::_getNodes().size();
+}
+
+int32_t ThreadPool::getCurrentNode()
+{
+    return detail::_currentWorker ? detail::_currentWorker->node : -1;
 }
 
 ThreadPool::~ThreadPool()
 {
-    {
-        std::unique_lock<std::mutex> lock(_mutex);
-        _stop = true;
-        _condition.notify_all();
-    }
-    joinAll();
+    delete _impl;
 }
 
 size_t ThreadPool::getSize() const
 {
-    return _threads.size();
+    return _impl->size;
+}
+
+size_t ThreadPool::getRunningThreads() const
+{
+    return _impl->running;
+}
+
+void ThreadPool::resize(const size_t size)
+{
+    _impl->resize(size);
+}
+
+void ThreadPool::setIdleTimeout(const uint32_t timeout)
+{
+    std::unique_lock<std::mutex> lock(_impl->sleepMutex);
+    _impl->idleTimeout = timeout;
+    _impl->condition.notify_all();
+}
+
+uint32_t ThreadPool::getIdleTimeout() const
+{
+    return _impl->idleTimeout;
 }
 
 bool ThreadPool::hasPendingJobs() const
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-    return !_tasks.empty();
+    return _impl->pending.load() > 0;
+}
+
+bool ThreadPool::waitIdle(const uint32_t timeout)
+{
+    return _impl->waitIdle(timeout);
+}
+
+void ThreadPool::drain()
+{
+    _impl->drain();
+}
+
+ThreadPool::Timer::Timer(std::shared_ptr<detail::Timer> impl)
+    : _impl(std::move(impl))
+{
+}
+
+bool ThreadPool::Timer::cancel()
+{
+    return _impl && _impl->cancel();
+}
+
+bool ThreadPool::Timer::isScheduled() const
+{
+    return _impl && _impl->isScheduled();
+}
+
+void ThreadPool::setStarvationTimeout(const uint32_t timeout)
+{
+    _impl->starvationTimeout = timeout;
 }
 
-void ThreadPool::joinAll()
+uint32_t ThreadPool::getStarvationTimeout() const
 {
-    for (auto& thread : _threads)
-        thread.join();
+    return _impl->starvationTimeout;
 }
 
-void ThreadPool::work()
+ThreadPool::Statistics ThreadPool::getStatistics(const Priority priority) const
 {
-    for (;;)
+    LBASSERT(priority < NUM_PRIORITIES);
+    const auto relaxed = std::memory_order_relaxed;
+    uint64_t started = 0;
+    uint64_t waitTime = 0;
+    uint64_t maxWaitTime = 0;
+    Statistics statistics{0, 0, 0.f, 0.f};
+
+    const size_t high = _impl->high;
+    for (size_t i = 0; i < high; ++i)
+    {
+        const detail::Level& level = _impl->slots[i]->levels[priority];
+        statistics.queued += level.size.load(relaxed);
+        started += level.started.load(relaxed);
+        waitTime += level.waitTime.load(relaxed);
+        maxWaitTime = std::max(maxWaitTime, level.maxWaitTime.load(relaxed));
+    }
+
+    statistics.started = started;
+    if (started > 0)
+        statistics.averageWait = float(waitTime) / started / 1000000.f;
+    statistics.maxWait = float(maxWaitTime) / 1000000.f;
+    return statistics;
+}
+
+ThreadPool::Timer ThreadPool::_postTimer(Task&& task, const uint32_t delay,
+                                        const uint32_t period)
+{
+    return Timer(_impl->postTimer(std::move(task), delay, period));
+}
+
+ThreadPool::Metrics ThreadPool::getMetrics() const
+{
+    const auto relaxed = std::memory_order_relaxed;
+    Metrics metrics;
+    metrics.posted = 0;
+    metrics.completed = 0;
+    metrics.steals = 0;
+    metrics.queued = _impl->pending.load(relaxed);
+    metrics.maxQueued = _impl->maxPending.load(relaxed);
+    metrics.waitTimes.fill(0);
+    metrics.executionTimes.fill(0);
+
+    const auto addCounters = [&metrics, relaxed](
+        const detail::Counters& counters) {
+        metrics.completed += counters.executed.load(relaxed);
+        metrics.steals += counters.steals.load(relaxed);
+        for (size_t i = 0; i < HISTOGRAM_SIZE; ++i)
+            metrics.executionTimes[i] += counters.histogram[i].load(relaxed);
+    };
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            detail::SteadyClock::now().time_since_epoch())
+                            .count();
+    const size_t high = _impl->high;
+    for (size_t i = 0; i < high; ++i)
     {
-        std::function<void()> task;
+        const detail::Worker& worker = *_impl->slots[i];
+        for (const detail::Level& level : worker.levels)
         {
-            std::unique_lock<std::mutex> lock(_mutex);
-            _condition.wait(lock, [this] { return _stop || !_tasks.empty(); });
-            if (_stop)
-                return;
-            task = std::move(_tasks.front());
-            _tasks.pop();
+            metrics.posted += level.posted.load(relaxed);
+            for (size_t j = 0; j < HISTOGRAM_SIZE; ++j)
+                metrics.waitTimes[j] += level.waitHistogram[j].load(relaxed);
+        }
+        addCounters(worker.counters);
+
+        if (worker.active)
+        {
+            const uint64_t busy = worker.counters.busyTime.load(relaxed) -
+                                  worker.busyAtStart.load(relaxed);
+            const int64_t elapsed = now - worker.since.load(relaxed);
+            metrics.busyRatios.push_back(
+                elapsed > 0 ? std::min(float(busy) / elapsed, 1.f) : 0.f);
         }
-        task();
     }
+
+    std::lock_guard<std::mutex> lock(_impl->externalMutex);
+    addCounters(_impl->external);
+    return metrics;
+}
+
+void ThreadPool::_post(Task&& task, const int32_t node, const Priority priority,
+                       const uint32_t deadline)
+{
+    _impl->post(std::move(task), node, priority, deadline);
 }
 }
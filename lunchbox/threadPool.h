@@ -17,39 +17,218 @@
 #pragma once
 
 #include <lunchbox/api.h>
+#include <lunchbox/task.h>  // inline usage
+#include <lunchbox/types.h> // LB_TIMEOUT_INDEFINITE
 
-#include <condition_variable> // member
+#include <algorithm>
+#include <array>
 #include <functional>
 #include <future> // inline return value
-#include <queue>  // member
-#include <thread> // member
-#include <vector> // member
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace lunchbox
 {
+namespace detail
+{
+class ThreadPool;
+class Timer;
+
+/** Fulfills a promise with the result of a function, used by post(). */
+template <typename R, typename F>
+struct PromiseTask
+{
+    std::promise<R> promise;
+    F function;
+
+    void operator()()
+    {
+        try
+        {
+            promise.set_value(function());
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+template <typename F>
+struct PromiseTask<void, F>
+{
+    std::promise<void> promise;
+    F function;
+
+    void operator()()
+    {
+        try
+        {
+            function();
+            promise.set_value();
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+}
+
 /**
  * Thread pool for tasks execution.
  * A task is a callable object taking no arguments and returing a value or void.
  * All the member methods are thread safe.
  *
+ * Each worker thread has its own task queue. Tasks posted from a worker thread
+ * are queued locally, other tasks are distributed round-robin. Idle workers
+ * steal tasks from the other workers before going to sleep. Each worker
+ * executes its own tasks in posting order.
+ *
+ * Small tasks are posted without memory allocations: the callable is stored
+ * inline in a Task, and the shared states of the returned futures come from a
+ * thread-local memory pool.
+ *
+ * A pool may be bound to one NUMA node, or spread over all nodes, with each
+ * worker pinned to the cores of its node. The topology is detected using hwloc
+ * if available, and /sys/devices/system/node on Linux otherwise. Tasks may be
+ * posted with a node hint, which queues them to a worker of that node. Idle
+ * workers steal tasks of their own node first.
+ *
+ * Tasks may be posted with a priority and a deadline. Each worker executes its
+ * most urgent task first: the tasks of the highest priority, within one
+ * priority the tasks with a deadline in deadline order, and then the other
+ * tasks in posting order. To avoid starvation, a task which waited longer than
+ * the starvation timeout is executed before more urgent tasks.
+ *
+ * Delayed and periodic tasks are kept in a timer heap served by one timer
+ * thread per pool, which is started on first use and posts due tasks to the
+ * workers.
+ *
  * Example: @include tests/threadPool.cpp
  */
 class ThreadPool
 {
 public:
+    /** Worker placement for the NUMA-aware constructor. @version 1.18 */
+    enum Placement
+    {
+        UNPINNED = -2, //!< Workers are not pinned
+        ALL_NODES = -1 //!< Workers are spread evenly over all NUMA nodes
+    };
+
+    /** Task priorities, in decreasing urgency. @version 1.18 */
+    enum Priority
+    {
+        PRIORITY_HIGH,   //!< Latency-sensitive tasks
+        PRIORITY_NORMAL, //!< The default priority
+        PRIORITY_LOW,    //!< Background tasks
+        NUM_PRIORITIES
+    };
+
+    /** Statistics of one priority level. @version 1.18 */
+    struct Statistics
+    {
+        size_t queued;     //!< Number of tasks waiting for execution
+        uint64_t started;  //!< Number of started tasks
+        float averageWait; //!< Mean time in ms between posting and start
+        float maxWait;     //!< Longest time in ms between posting and start
+    };
+
+    /** The number of buckets of the Metrics histograms. @version 1.18 */
+    enum
+    {
+        HISTOGRAM_SIZE = 32
+    };
+
+    /** A histogram of times, see Metrics. @version 1.18 */
+    typedef std::array<uint64_t, HISTOGRAM_SIZE> Histogram;
+
+    /**
+     * Counters of a thread pool since its construction.
+     *
+     * Bucket 0 of the histograms counts times below one microsecond, bucket i
+     * counts times in [2^(i-1), 2^i) microseconds, and the last bucket all
+     * longer times.
+     * @version 1.18
+     */
+    struct Metrics
+    {
+        uint64_t posted;    //!< Number of posted tasks
+        uint64_t completed; //!< Number of executed tasks
+        uint64_t steals;    //!< Number of tasks stolen by idle workers
+        size_t queued;      //!< Number of tasks waiting for execution
+        size_t maxQueued;   //!< High-water mark of queued tasks
+        Histogram waitTimes;      //!< Times between posting and start
+        Histogram executionTimes; //!< Execution times
+        /** Busy time ratio of each running worker since its start. */
+        std::vector<float> busyRatios;
+    };
+
+    /**
+     * Handle of a delayed or periodic task.
+     * @sa postAfter(), postEvery()
+     * @version 1.18
+     */
+    class Timer
+    {
+    public:
+        /** Construct an empty handle. @version 1.18 */
+        Timer() {}
+        /**
+         * Cancel the task.
+         *
+         * An execution already in progress is not interrupted, but a periodic
+         * task is not rescheduled afterwards.
+         *
+         * @return true if future executions were cancelled: a one-shot task
+         *         which did not start yet, or a periodic task, including
+         *         during one of its executions. false if the task was already
+         *         cancelled, or is a one-shot task which started or is done.
+         * @version 1.18
+         */
+        LUNCHBOX_API bool cancel();
+
+        /**
+         * @return true if the task has a future execution. A periodic task
+         *         remains scheduled during its executions.
+         * @version 1.18
+         */
+        LUNCHBOX_API bool isScheduled() const;
+
+    private:
+        friend class ThreadPool;
+        explicit Timer(std::shared_ptr<detail::Timer> impl);
+        std::shared_ptr<detail::Timer> _impl;
+    };
+
     /** @return the application-global thread pool. */
     static LUNCHBOX_API ThreadPool& getInstance();
 
     /**
      * Construct a new ThreadPool.
      *
-     * @param size number of threads in the thread pool
+     * @param size number of threads in the thread pool, at least one.
      * @sa getInstance() for the recommended thread pool.
      */
     LUNCHBOX_API ThreadPool(const size_t size);
+
+    /**
+     * Construct a new ThreadPool pinned to NUMA nodes.
+     *
+     * @param size number of threads in the thread pool, 0 for one thread per
+     *             core of the used nodes.
+     * @param node the index of the node all workers are pinned to, ALL_NODES
+     *             to pin the workers round-robin to all nodes, or UNPINNED.
+     * @version 1.18
+     */
+    LUNCHBOX_API ThreadPool(const size_t size, const int32_t node);
     /**
      * Destroy this thread pool.
-     * Will block until all the tasks are done.
+     * Will block until all the tasks are done, including tasks posted by
+     * running tasks, and all threads have been joined. Delayed tasks which
+     * are not yet due are cancelled and periodic tasks stop.
      */
     LUNCHBOX_API ~ThreadPool();
 
@@ -58,6 +237,85 @@ public:
      */
     LUNCHBOX_API size_t getSize() const;
 
+    /**
+     * @return the number of currently running threads, which is less than
+     *         getSize() if threads were stopped on idle timeout.
+     * @version 1.18
+     */
+    LUNCHBOX_API size_t getRunningThreads() const;
+
+    /**
+     * Change the number of threads in the thread pool.
+     *
+     * New threads are started immediately. Surplus threads finish the tasks
+     * queued to them and exit, without blocking the caller.
+     *
+     * @param size the new number of threads, at least one.
+     * @version 1.18
+     */
+    LUNCHBOX_API void resize(const size_t size);
+
+    /**
+     * Set the time after which idle threads are stopped.
+     *
+     * Stopped threads are restarted, up to getSize(), when tasks are posted
+     * while all running threads are busy. LB_TIMEOUT_INDEFINITE, the default,
+     * keeps all threads running.
+     *
+     * @param timeout the idle time in milliseconds.
+     * @version 1.18
+     */
+    LUNCHBOX_API void setIdleTimeout(const uint32_t timeout);
+
+    /** @return the idle timeout in milliseconds. @version 1.18 */
+    LUNCHBOX_API uint32_t getIdleTimeout() const;
+
+    /**
+     * Set the time after which a waiting task is executed before more urgent
+     * tasks.
+     *
+     * The default is 100 ms. LB_TIMEOUT_INDEFINITE disables the starvation
+     * protection.
+     *
+     * @param timeout the starvation timeout in milliseconds.
+     * @version 1.18
+     */
+    LUNCHBOX_API void setStarvationTimeout(const uint32_t timeout);
+
+    /** @return the starvation timeout in milliseconds. @version 1.18 */
+    LUNCHBOX_API uint32_t getStarvationTimeout() const;
+
+    /**
+     * @return the queue depth and wait time statistics of the given priority
+     *         since the construction of the pool.
+     * @version 1.18
+     */
+    LUNCHBOX_API Statistics getStatistics(const Priority priority) const;
+
+    /**
+     * @return the counters of this pool.
+     *
+     * The counters are maintained per worker without synchronization between
+     * workers, and are aggregated by this method. They are therefore cheap to
+     * maintain, but not an atomic snapshot of a busy pool.
+     * @version 1.18
+     */
+    LUNCHBOX_API Metrics getMetrics() const;
+
+    /**
+     * @return the number of NUMA nodes with CPUs, 1 if the topology is
+     *         unknown.
+     * @version 1.18
+     */
+    static LUNCHBOX_API size_t getNumNodes();
+
+    /**
+     * @return the NUMA node the calling worker thread is pinned to, -1 if it
+     *         is not a pinned worker thread.
+     * @version 1.18
+     */
+    static LUNCHBOX_API int32_t getCurrentNode();
+
     /**
      * Post a new task in the thread pool.
      * @return a std::future containing the future result.
@@ -72,49 +330,188 @@ public:
     template <typename F>
     inline void postDetached(F&& f);
 
+    /**
+     * Post a new task to a worker of the given NUMA node.
+     *
+     * The task is executed by a worker of another node only if no worker of
+     * the node is running, or when it is stolen by an otherwise idle worker.
+     * The hint is ignored if the pool is not spread over ALL_NODES.
+     * @return a std::future containing the future result.
+     * @version 1.18
+     */
+    template <typename F>
+    inline std::future<typename std::result_of<F()>::type> post(F&& f,
+                                                                size_t node);
+
+    /**
+     * Post a detached task to a worker of the given NUMA node.
+     * @sa post(F&&, size_t)
+     * @version 1.18
+     */
+    template <typename F>
+    inline void postDetached(F&& f, size_t node);
+
+    /**
+     * Post a new task with the given priority and deadline.
+     *
+     * @param f the task.
+     * @param priority the priority of the task.
+     * @param deadline the time in milliseconds from now until the task should
+     *                 be started, or LB_TIMEOUT_INDEFINITE.
+     * @return a std::future containing the future result.
+     * @version 1.18
+     */
+    template <typename F>
+    inline std::future<typename std::result_of<F()>::type> post(
+        F&& f, Priority priority, uint32_t deadline = LB_TIMEOUT_INDEFINITE);
+
+    /**
+     * Post a detached task with the given priority and deadline.
+     * @sa post(F&&, Priority, uint32_t)
+     * @version 1.18
+     */
+    template <typename F>
+    inline void postDetached(F&& f, Priority priority,
+                             uint32_t deadline = LB_TIMEOUT_INDEFINITE);
+
+    /**
+     * Post a task executed once after the given delay.
+     *
+     * @param delay the delay in milliseconds.
+     * @param f the task.
+     * @return the handle to cancel the task.
+     * @version 1.18
+     */
+    template <typename F>
+    inline Timer postAfter(uint32_t delay, F&& f);
+
+    /**
+     * Post a task executed periodically, starting one period from now.
+     *
+     * The task is executed at a fixed rate. Executions never overlap:
+     * executions missed because the task ran late or long are skipped.
+     *
+     * @param period the period in milliseconds.
+     * @param f the task.
+     * @return the handle to stop the task.
+     * @version 1.18
+     */
+    template <typename F>
+    inline Timer postEvery(uint32_t period, F&& f);
+
     /** @return true if there are pending tasks to be executed. */
     LUNCHBOX_API bool hasPendingJobs() const;
 
+    /**
+     * Wait until all posted tasks have finished.
+     *
+     * Includes tasks posted while waiting. Must not be called from a task of
+     * this pool.
+     *
+     * @param timeout the maximum time to wait in milliseconds.
+     * @return true if the pool is idle, false on timeout.
+     * @version 1.18
+     */
+    LUNCHBOX_API bool waitIdle(const uint32_t timeout = LB_TIMEOUT_INDEFINITE);
+
+    /**
+     * Execute queued tasks from the calling thread until the pool is idle.
+     *
+     * Must not be called from a task of this pool.
+     * @version 1.18
+     */
+    LUNCHBOX_API void drain();
+
 private:
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
 
-    LUNCHBOX_API void joinAll();
-    LUNCHBOX_API void work();
+    LUNCHBOX_API void _post(Task&& task, int32_t node = -1,
+                            Priority priority = PRIORITY_NORMAL,
+                            uint32_t deadline = LB_TIMEOUT_INDEFINITE);
+    LUNCHBOX_API Timer _postTimer(Task&& task, uint32_t delay,
+                                  uint32_t period);
 
-    std::vector<std::thread> _threads;
-    std::queue<std::function<void()> > _tasks;
-    mutable std::mutex _mutex;
-    std::condition_variable _condition;
-    bool _stop;
+    detail::ThreadPool* const _impl;
 };
 
 template <typename F>
 std::future<typename std::result_of<F()>::type> ThreadPool::post(F&& f)
 {
     using ReturnType = typename std::result_of<F()>::type;
+    using Function = typename std::decay<F>::type;
 
-    auto task =
-        std::make_shared<std::packaged_task<ReturnType()> >(std::forward<F>(f));
-
-    auto res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(_mutex);
-        _tasks.emplace([task]() { (*task)(); });
-    }
-    _condition.notify_one();
+    std::promise<ReturnType> promise(std::allocator_arg,
+                                     TaskAllocator<ReturnType>());
+    auto res = promise.get_future();
+    _post(detail::PromiseTask<ReturnType, Function>{std::move(promise),
+                                                    std::forward<F>(f)});
     return res;
 }
 
 template <typename F>
 void ThreadPool::postDetached(F&& f)
 {
-    {
-        std::unique_lock<std::mutex> lock(_mutex);
-        _tasks.emplace(f);
-    }
-    _condition.notify_one();
+    _post(Task(std::forward<F>(f)));
+}
+
+template <typename F>
+std::future<typename std::result_of<F()>::type> ThreadPool::post(
+    F&& f, const size_t node)
+{
+    using ReturnType = typename std::result_of<F()>::type;
+    using Function = typename std::decay<F>::type;
+
+    std::promise<ReturnType> promise(std::allocator_arg,
+                                     TaskAllocator<ReturnType>());
+    auto res = promise.get_future();
+    _post(detail::PromiseTask<ReturnType, Function>{std::move(promise),
+                                                    std::forward<F>(f)},
+          int32_t(node));
+    return res;
+}
+
+template <typename F>
+void ThreadPool::postDetached(F&& f, const size_t node)
+{
+    _post(Task(std::forward<F>(f)), int32_t(node));
+}
+
+template <typename F>
+std::future<typename std::result_of<F()>::type> ThreadPool::post(
+    F&& f, const Priority priority, const uint32_t deadline)
+{
+    using ReturnType = typename std::result_of<F()>::type;
+    using Function = typename std::decay<F>::type;
+
+    std::promise<ReturnType> promise(std::allocator_arg,
+                                     TaskAllocator<ReturnType>());
+    auto res = promise.get_future();
+    _post(detail::PromiseTask<ReturnType, Function>{std::move(promise),
+                                                    std::forward<F>(f)},
+          -1, priority, deadline);
+    return res;
+}
+
+template <typename F>
+void ThreadPool::postDetached(F&& f, const Priority priority,
+                              const uint32_t deadline)
+{
+    _post(Task(std::forward<F>(f)), -1, priority, deadline);
+}
+
+template <typename F>
+ThreadPool::Timer ThreadPool::postAfter(const uint32_t delay, F&& f)
+{
+    return _postTimer(Task(std::forward<F>(f)), delay, 0);
+}
+
+template <typename F>
+ThreadPool::Timer ThreadPool::postEvery(const uint32_t period, F&& f)
+{
+    return _postTimer(Task(std::forward<F>(f)), period,
+                      std::max(period, uint32_t(1)));
 }
 }
@@ -0,0 +1,61 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/clock.h>
+#include <lunchbox/futex.h>
+#include <lunchbox/test.h>
+#include <lunchbox/thread.h>
+
+#define NTHREADS 4
+
+lunchbox::Futex futex;
+
+class Waiter : public lunchbox::Thread
+{
+public:
+    virtual void run()
+    {
+        for (uint32_t value = futex; value < 2; value = futex)
+            futex.wait(value);
+    }
+};
+
+int main(int, char**)
+{
+    // value differs, returns immediately
+    TEST(futex.wait(42));
+
+    // nobody wakes us, times out
+    lunchbox::Clock clock;
+    TEST(!futex.wait(0, 50));
+    TEST(clock.getTime64() >= 45);
+
+    Waiter waiters[NTHREADS];
+    for (size_t i = 0; i < NTHREADS; ++i)
+        TEST(waiters[i].start());
+
+    lunchbox::sleep(10);
+    futex = 1;
+    futex.wakeOne();
+    lunchbox::sleep(10);
+    futex = 2;
+    futex.wakeAll();
+
+    for (size_t i = 0; i < NTHREADS; ++i)
+        TEST(waiters[i].join());
+    return EXIT_SUCCESS;
+}
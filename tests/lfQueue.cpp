@@ -21,6 +21,8 @@
 #include <lunchbox/test.h>
 #include <lunchbox/thread.h>
 
+#include <memory>
+
 #define RUNTIME 1000 /*ms*/
 
 lunchbox::LFQueue<uint64_t> queue(1024);
@@ -55,8 +57,147 @@ public:
     }
 };
 
+void testBatch()
+{
+    lunchbox::LFQueue<uint64_t> batchQueue(7);
+    uint64_t in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    uint64_t out[10] = {0};
+
+    TEST(batchQueue.pop(out, 10) == 0);
+    TEST(batchQueue.push(in, 5) == 5);
+    TEST(batchQueue.pop(out, 3) == 3);
+    TEST(out[0] == 0 && out[1] == 1 && out[2] == 2);
+
+    // wraps around the end of the ring buffer
+    TEST(batchQueue.push(in + 5, 5) == 5);
+    TEST(batchQueue.push(in, 10) == 0);
+    TEST(batchQueue.pop(out, 10) == 7);
+    for (size_t i = 0; i < 7; ++i)
+        TEST(out[i] == i + 3);
+    TEST(batchQueue.isEmpty());
+
+    TEST(batchQueue.push(in, 10) == 7);
+    uint64_t item = 0;
+    TEST(batchQueue.pop(item));
+    TEST(item == 0);
+}
+
+struct Counted
+{
+    explicit Counted(const int v)
+        : value(new int(v))
+    {
+        ++nAlive;
+    }
+    Counted(Counted&& from)
+        : value(std::move(from.value))
+    {
+        ++nAlive;
+    }
+    Counted& operator=(Counted&& from)
+    {
+        value = std::move(from.value);
+        return *this;
+    }
+    ~Counted() { --nAlive; }
+
+    std::unique_ptr<int> value;
+    static int nAlive;
+};
+int Counted::nAlive = 0;
+
+void testMoveOnly()
+{
+    {
+        lunchbox::LFQueue<Counted> movingQueue(3);
+        TEST(Counted::nAlive == 0); // slots are not constructed upfront
+
+        TEST(movingQueue.emplace(1));
+        TEST(movingQueue.push(Counted(2)));
+        TEST(movingQueue.emplace(3));
+        TEST(!movingQueue.emplace(4));
+        TEST(Counted::nAlive == 3);
+
+        Counted result(0);
+        TEST(movingQueue.pop(result));
+        TEST(*result.value == 1);
+        TEST(Counted::nAlive == 3);
+
+        Counted results[2] = {Counted(0), Counted(0)};
+        TEST(movingQueue.pop(results, 2) == 2);
+        TEST(*results[0].value == 2 && *results[1].value == 3);
+        TEST(Counted::nAlive == 3);
+
+        TEST(movingQueue.emplace(5));
+        TEST(movingQueue.emplace(6));
+        TEST(Counted::nAlive == 5);
+        movingQueue.clear();
+        TEST(Counted::nAlive == 3);
+        TEST(movingQueue.emplace(7));
+    }
+    TEST(Counted::nAlive == 0);
+
+    lunchbox::LFQueue<std::unique_ptr<int> > ptrQueue(1);
+    TEST(ptrQueue.push(std::unique_ptr<int>(new int(42))));
+    std::unique_ptr<int> ptr;
+    TEST(ptrQueue.pop(ptr));
+    TEST(*ptr == 42);
+}
+
+class BlockingReader : public lunchbox::Thread
+{
+public:
+    explicit BlockingReader(lunchbox::LFQueue<uint64_t>& queue_)
+        : queue(queue_)
+    {
+    }
+
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            uint64_t item = 0;
+            TEST(queue.timedPop(LB_TIMEOUT_INDEFINITE, item));
+            TEST(item == i);
+            if (i % 100 == 0)
+                lunchbox::sleep(1); // let the writer wait for free space
+        }
+    }
+
+    lunchbox::LFQueue<uint64_t>& queue;
+};
+
+void testBlocking()
+{
+    lunchbox::LFQueue<uint64_t> blockingQueue(4);
+    uint64_t item = 0;
+
+    lunchbox::Clock clock;
+    TEST(!blockingQueue.timedPop(20, item));
+    TEST(clock.getTime64() >= 15);
+
+    for (uint64_t i = 0; i < 4; ++i)
+        TEST(blockingQueue.timedPush(0, i));
+    clock.reset();
+    TEST(!blockingQueue.timedPush(20, 4));
+    TEST(clock.getTime64() >= 15);
+    blockingQueue.clear();
+
+    BlockingReader reader(blockingQueue);
+    TEST(reader.start());
+    lunchbox::sleep(10); // let the reader go to sleep
+    for (uint64_t i = 0; i < 1000; ++i)
+        TEST(blockingQueue.timedPush(LB_TIMEOUT_INDEFINITE, i));
+    TEST(reader.join());
+    TEST(blockingQueue.isEmpty());
+}
+
 int main(int, char**)
 {
+    testBatch();
+    testMoveOnly();
+    testBlocking();
+
     ReadThread reader;
     uint64_t nOps = 0;
     uint64_t nEmpty = 0;
@@ -0,0 +1,125 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <iostream>
+#include <lunchbox/clock.h>
+#include <lunchbox/mpmcQueue.h>
+#include <lunchbox/test.h>
+#include <lunchbox/thread.h>
+
+#include <atomic>
+
+#define NOPS 100000
+#define NTHREADS 4
+
+lunchbox::MPMCQueue<uint64_t> queue(1000);
+std::atomic<uint64_t> nRead(0);
+std::atomic<uint64_t> sum(0);
+
+class WriteThread : public lunchbox::Thread
+{
+public:
+    WriteThread()
+        : index(0)
+    {
+    }
+    virtual ~WriteThread() {}
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < NOPS; ++i)
+        {
+            const uint64_t item = (index << 32) | i;
+            while (!queue.push(item))
+                lunchbox::Thread::yield();
+        }
+    }
+
+    uint64_t index;
+};
+
+class ReadThread : public lunchbox::Thread
+{
+public:
+    virtual ~ReadThread() {}
+    virtual void run()
+    {
+        uint64_t last[NTHREADS];
+        for (size_t i = 0; i < NTHREADS; ++i)
+            last[i] = 0;
+
+        while (nRead < NTHREADS * NOPS)
+        {
+            uint64_t item = 0;
+            if (!queue.pop(item))
+            {
+                lunchbox::Thread::yield();
+                continue;
+            }
+
+            // items of one writer are seen in order by each reader
+            const uint64_t writer = item >> 32;
+            const uint64_t value = item & 0xffffffffull;
+            TEST(writer < NTHREADS);
+            TESTINFO(value + 1 > last[writer], value << " " << last[writer]);
+            last[writer] = value + 1;
+
+            sum += value;
+            ++nRead;
+        }
+    }
+};
+
+int main(int, char**)
+{
+    TEST(queue.getCapacity() == 1024);
+    TEST(queue.isEmpty());
+
+    uint64_t item = 0;
+    TEST(!queue.pop(item));
+    for (size_t i = 0; i < queue.getCapacity(); ++i)
+        TEST(queue.push(i));
+    TEST(!queue.push(0));
+    for (size_t i = 0; i < queue.getCapacity(); ++i)
+    {
+        TEST(queue.pop(item));
+        TEST(item == i);
+    }
+    TEST(queue.isEmpty());
+
+    WriteThread writers[NTHREADS];
+    ReadThread readers[NTHREADS];
+
+    lunchbox::Clock clock;
+    for (size_t i = 0; i < NTHREADS; ++i)
+    {
+        writers[i].index = i;
+        TEST(writers[i].start());
+        TEST(readers[i].start());
+    }
+    for (size_t i = 0; i < NTHREADS; ++i)
+    {
+        TEST(writers[i].join());
+        TEST(readers[i].join());
+    }
+    const float time = clock.getTimef();
+
+    TEST(nRead == NTHREADS * NOPS);
+    TEST(sum == uint64_t(NTHREADS) * NOPS * (NOPS - 1) / 2);
+    TEST(queue.isEmpty());
+    std::cout << nRead / time << " ops/ms" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/mtPriorityQueue.h>
+#include <lunchbox/test.h>
+#include <lunchbox/thread.h>
+
+#define NOPS 10000
+#define NTHREADS 4
+
+enum Level
+{
+    CONTROL,
+    DATA,
+    BULK
+};
+
+typedef lunchbox::MTPriorityQueue<uint64_t> Queue;
+Queue queue(3, 16);
+Queue::Group group(NTHREADS + 1);
+
+class WriteThread : public lunchbox::Thread
+{
+public:
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < NOPS; ++i)
+            queue.push(i, i % 3);
+    }
+};
+
+class ReadThread : public lunchbox::Thread
+{
+public:
+    ReadThread()
+        : nOps(0)
+    {
+    }
+    virtual void run()
+    {
+        uint64_t item = 0;
+        while (queue.popBarrier(item, group))
+            ++nOps;
+    }
+
+    size_t nOps;
+};
+
+int main(int, char**)
+{
+    TEST(queue.getLevels() == 3);
+    queue.push(1, BULK);
+    queue.push(2, DATA);
+    queue.push(3, BULK);
+    queue.push(4, CONTROL);
+    queue.push(5, DATA);
+    queue.push(6, CONTROL);
+    TEST(queue.getSize() == 6);
+
+    // priority order, FIFO within one level
+    TEST(queue.pop() == 4);
+    uint64_t item = 0;
+    TEST(queue.tryPop(item));
+    TEST(item == 6);
+    TEST(queue.timedPop(0, item));
+    TEST(item == 2);
+    const std::vector<uint64_t> range = queue.timedPopRange(0, 2, 2);
+    TEST(range.size() == 2);
+    TEST(range[0] == 5 && range[1] == 1);
+    TEST(queue.timedPopRange(10, 2).empty());
+    TEST(queue.pop() == 3);
+    TEST(queue.isEmpty());
+    TEST(!queue.timedPop(10, item));
+
+    // writer is throttled by the maximum size, readers drain with a barrier
+    WriteThread writer;
+    ReadThread readers[NTHREADS];
+    TEST(writer.start());
+    for (size_t i = 0; i < NTHREADS; ++i)
+        TEST(readers[i].start());
+
+    TEST(writer.join());
+    size_t nOps = 0;
+    while (queue.popBarrier(item, group))
+        ++nOps;
+    for (size_t i = 0; i < NTHREADS; ++i)
+    {
+        TEST(readers[i].join());
+        nOps += readers[i].nOps;
+    }
+    TEST(nOps == NOPS);
+    TEST(queue.isEmpty());
+    return EXIT_SUCCESS;
+}
@@ -20,10 +20,13 @@
 #include <lunchbox/clock.h>
 #include <lunchbox/compiler.h>
 #include <lunchbox/mtQueue.h>
+#include <lunchbox/sleep.h>
 #include <lunchbox/test.h>
 #include <lunchbox/thread.h>
 #include <pthread.h>
 
+#include <memory>
+
 #define NOPS 100000
 #define NTHREADS 4
 
@@ -55,8 +58,123 @@ public:
     }
 };
 
+lunchbox::MTQueue<uint64_t> boundedQueue(1);
+
+class WriteThread : public lunchbox::Thread
+{
+public:
+    virtual ~WriteThread() {}
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < NOPS; ++i)
+            boundedQueue.push(i);
+    }
+};
+
+#define NTICKS 60
+lunchbox::MTQueue<uint64_t> tickQueue;
+
+class TickThread : public lunchbox::Thread
+{
+public:
+    virtual ~TickThread() {}
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < NTICKS; ++i)
+        {
+            lunchbox::sleep(5);
+            tickQueue.push(i);
+        }
+    }
+};
+
+void testBackpressure()
+{
+    uint64_t item = 0;
+    TEST(!boundedQueue.timedPop(10, item));
+
+    // writer blocks on the full queue, reader blocks on the empty queue
+    WriteThread writer;
+    TEST(writer.start());
+    for (uint64_t i = 0; i < NOPS; ++i)
+        TEST(boundedQueue.pop() == i);
+    TEST(writer.join());
+    TEST(boundedQueue.isEmpty());
+}
+
+void testMoveOnly()
+{
+    typedef std::unique_ptr<uint64_t> Ptr;
+    lunchbox::MTQueue<Ptr> ptrQueue;
+
+    ptrQueue.push(Ptr(new uint64_t(1)));
+    ptrQueue.emplace(new uint64_t(2));
+    std::vector<Ptr> ptrs;
+    ptrs.emplace_back(new uint64_t(3));
+    ptrs.emplace_back(new uint64_t(4));
+    ptrQueue.push(std::move(ptrs));
+    TEST(ptrs.empty());
+    TEST(ptrQueue.getSize() == 4);
+
+    TEST(*ptrQueue.pop() == 1);
+    Ptr ptr;
+    TEST(ptrQueue.tryPop(ptr));
+    TEST(*ptr == 2);
+    TEST(ptrQueue.timedPop(0, ptr));
+    TEST(*ptr == 3);
+
+    lunchbox::MTQueue<Ptr> moved(std::move(ptrQueue));
+    TEST(moved.getSize() == 1);
+    const std::vector<Ptr> range = moved.timedPopRange(0);
+    TEST(range.size() == 1);
+    TEST(*range[0] == 4);
+}
+
+void testPopRange()
+{
+    lunchbox::MTQueue<uint64_t> rangeQueue;
+    for (uint64_t i = 0; i < 10; ++i)
+        rangeQueue.push(i);
+
+    std::vector<uint64_t> buffer;
+    buffer.reserve(16);
+    const uint64_t* data = buffer.data();
+
+    TEST(rangeQueue.timedPopRange(0, buffer, 4, 4) == 4);
+    TEST(buffer.size() == 4 && buffer[0] == 0 && buffer[3] == 3);
+    buffer.clear();
+    TEST(rangeQueue.timedPopRange(0, buffer, 20) == 0);
+    TEST(buffer.empty());
+    TEST(rangeQueue.timedPopRange(0, buffer, 2, 3) == 3);
+    TEST(buffer.size() == 3 && buffer[0] == 4);
+    TEST(buffer.data() == data); // no reallocation
+
+    uint64_t items[8];
+    TEST(rangeQueue.tryPop(2, items) == 2);
+    TEST(items[0] == 7 && items[1] == 8);
+    TEST(rangeQueue.timedPopRange(0, items, 1, 8) == 1);
+    TEST(items[0] == 9);
+    TEST(rangeQueue.tryPop(8, items) == 0);
+
+    // one deadline for the whole call, even if updates arrive meanwhile
+    TickThread writer;
+    TEST(writer.start());
+    lunchbox::Clock clock;
+    TEST(tickQueue.timedPopRange(100, buffer, NTICKS + 1) == 0);
+    const int64_t time = clock.getTime64();
+    TESTINFO(time >= 99 && time < NTICKS * 5, time);
+    TEST(writer.join());
+    buffer.clear();
+    tickQueue.tryPop(NTICKS, buffer);
+    TEST(buffer.size() == NTICKS);
+}
+
 int main(int, char**)
 {
+    testBackpressure();
+    testMoveOnly();
+    testPopRange();
+
     ReadThread reader[NTHREADS];
     for (size_t i = 0; i < NTHREADS; ++i)
         TEST(reader[i].start());
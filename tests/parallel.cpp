@@ -0,0 +1,104 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/parallel.h>
+#include <lunchbox/test.h>
+
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#define SIZE 100000
+
+void testFor(lunchbox::ThreadPool& pool)
+{
+    std::vector<size_t> data(SIZE, 0);
+    lunchbox::parallelFor(size_t(0), data.size(), 16,
+                          [&data](const size_t i) { data[i] += i; }, pool);
+    for (size_t i = 0; i < SIZE; ++i)
+        TESTINFO(data[i] == i, i << ": " << data[i]);
+
+    // iterators and empty ranges
+    lunchbox::parallelFor(data.begin(), data.end(), 1,
+                          [](std::vector<size_t>::iterator i) { *i = 1; },
+                          pool);
+    TEST(std::accumulate(data.begin(), data.end(), size_t(0)) == SIZE);
+    lunchbox::parallelFor(0, 0, 1, [](int) { TEST(false); }, pool);
+}
+
+void testReduce(lunchbox::ThreadPool& pool)
+{
+    const size_t sum =
+        lunchbox::parallelReduce(size_t(1), size_t(SIZE + 1), 100, size_t(0),
+                                 [](const size_t i) { return i; },
+                                 [](const size_t a, const size_t b) {
+                                     return a + b;
+                                 },
+                                 pool);
+    TESTINFO(sum == size_t(SIZE) * (SIZE + 1) / 2, sum);
+}
+
+void testTransform(lunchbox::ThreadPool& pool)
+{
+    std::vector<int> input(SIZE);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int> output(SIZE, -1);
+    const auto end = lunchbox::parallelTransform(input.begin(), input.end(),
+                                                 output.begin(), 0,
+                                                 [](int i) { return 2 * i; },
+                                                 pool);
+    TEST(end == output.end());
+    for (int i = 0; i < SIZE; ++i)
+        TEST(output[i] == 2 * i);
+}
+
+void testException(lunchbox::ThreadPool& pool)
+{
+    try
+    {
+        lunchbox::parallelFor(0, SIZE, 1,
+                              [](const int i) {
+                                  if (i == SIZE / 2)
+                                      throw std::runtime_error("test");
+                              },
+                              pool);
+        TEST(false);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+}
+
+int main(int, char**)
+{
+    lunchbox::ThreadPool pool(4);
+    testFor(pool);
+    testReduce(pool);
+    testTransform(pool);
+    testException(pool);
+
+    // nested loops from within tasks of a single-threaded pool
+    lunchbox::ThreadPool single(1);
+    TEST(single
+             .post([&single] {
+                 testFor(single);
+                 testReduce(single);
+                 return true;
+             })
+             .get());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define TEST_RUNTIME 600 // seconds, needed for NighlyMemoryCheck
+#include <lunchbox/test.h>
+
+#include <lunchbox/clock.h>
+#include <lunchbox/debug.h>
+#include <lunchbox/init.h>
+#include <lunchbox/mpmcQueue.h>
+#include <lunchbox/mtQueue.h>
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+
+#define MAXTHREADS 64
+#define TIME 500 // ms
+#define QUEUESIZE 1024
+
+std::atomic<bool> _running(false);
+std::atomic<size_t> _nWriters(0);
+
+// MTQueue is bounded to the same size and blocks when full
+bool _push(lunchbox::MTQueue<uint64_t>& queue, const uint64_t item)
+{
+    queue.push(item);
+    return true;
+}
+
+bool _push(lunchbox::MPMCQueue<uint64_t>& queue, const uint64_t item)
+{
+    return queue.push(item);
+}
+
+bool _pop(lunchbox::MTQueue<uint64_t>& queue, uint64_t& item)
+{
+    return queue.tryPop(item);
+}
+
+bool _pop(lunchbox::MPMCQueue<uint64_t>& queue, uint64_t& item)
+{
+    return queue.pop(item);
+}
+
+template <class Q>
+class Writer : public lunchbox::Thread
+{
+public:
+    Writer()
+        : queue(0)
+    {
+    }
+
+    Q* queue;
+
+    virtual void run()
+    {
+        while (LB_LIKELY(_running))
+        {
+            if (!_push(*queue, 0))
+                lunchbox::Thread::yield();
+        }
+        --_nWriters;
+    }
+};
+
+template <class Q>
+void _test(const std::string& name)
+{
+    Writer<Q> writers[MAXTHREADS];
+    for (size_t i = 1; i <= MAXTHREADS; i = i << 1)
+    {
+        Q queue(QUEUESIZE);
+        _running = true;
+        _nWriters = i;
+        for (size_t j = 0; j < i; ++j)
+        {
+            writers[j].queue = &queue;
+            TEST(writers[j].start());
+        }
+
+        // single consumer drains the fan-in
+        size_t ops = 0;
+        uint64_t item = 0;
+        lunchbox::Clock clock;
+        while (clock.getTime64() < TIME)
+        {
+            if (_pop(queue, item))
+                ++ops;
+        }
+        _running = false;
+        while (_nWriters > 0)
+            _pop(queue, item);
+        const float time = clock.getTimef();
+
+        for (size_t j = 0; j < i; ++j)
+            TEST(writers[j].join());
+
+        std::cout << std::setw(20) << name << ", " << std::setw(12)
+                  << ops / time * 1000.f << ", " << std::setw(3) << i
+                  << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    TEST(lunchbox::init(argc, argv));
+
+    std::cout << "               Class,        ops/s, writers" << std::endl;
+    _test<lunchbox::MTQueue<uint64_t> >("MTQueue");
+    _test<lunchbox::MPMCQueue<uint64_t> >("MPMCQueue");
+
+    TEST(lunchbox::exit());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define TEST_RUNTIME 600 // seconds, needed for NighlyMemoryCheck
+#include <lunchbox/test.h>
+
+#include <lunchbox/clock.h>
+#include <lunchbox/debug.h>
+#include <lunchbox/init.h>
+#include <lunchbox/lfQueue.h>
+#include <lunchbox/spscQueue.h>
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+
+#define TIME 1000 // ms
+#define QUEUESIZE 1024
+
+std::atomic<bool> _running(false);
+
+template <class Q>
+class Reader : public lunchbox::Thread
+{
+public:
+    explicit Reader(Q& queue)
+        : ops(0)
+        , _queue(queue)
+    {
+    }
+
+    size_t ops;
+
+    virtual void run()
+    {
+        uint64_t expected = 0;
+        uint64_t item = 0;
+        for (;;)
+        {
+            const bool running = _running;
+            if (_queue.pop(item))
+            {
+                TEST(item == expected);
+                ++expected;
+            }
+            else if (!running)
+                break;
+        }
+        ops = expected;
+    }
+
+private:
+    Q& _queue;
+};
+
+template <class Q>
+void _test()
+{
+    Q queue(QUEUESIZE);
+    Reader<Q> reader(queue);
+
+    _running = true;
+    TEST(reader.start());
+
+    lunchbox::Clock clock;
+    uint64_t item = 0;
+    while (clock.getTime64() < TIME)
+    {
+        for (size_t i = 0; i < QUEUESIZE; ++i)
+            if (queue.push(item))
+                ++item;
+    }
+    _running = false;
+    TEST(reader.join());
+    const float time = clock.getTimef();
+
+    TEST(reader.ops == item);
+    std::cout << std::setw(30) << lunchbox::className(queue) << ", "
+              << std::setw(12) << item / time * 1000.f << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    TEST(lunchbox::init(argc, argv));
+
+    std::cout << "                         Class,        ops/s" << std::endl;
+    _test<lunchbox::LFQueue<uint64_t> >();
+    _test<lunchbox::SPSCQueue<uint64_t> >();
+
+    TEST(lunchbox::exit());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define TEST_RUNTIME 600 // seconds, needed for NighlyMemoryCheck
+#include <lunchbox/test.h>
+
+#include <lunchbox/clock.h>
+#include <lunchbox/init.h>
+#include <lunchbox/thread.h>
+#include <lunchbox/threadPool.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#define NTASKS 10000000
+#define BATCH 10000 // tasks in flight, bounds the memory used by the queues
+
+std::atomic<size_t> _allocations(0);
+
+void* operator new(size_t size)
+{
+    ++_allocations;
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void _report(const std::string& name, const float time, const size_t allocs)
+{
+    std::cout << std::setw(12) << name << ", " << std::setw(12)
+              << NTASKS / time * 1000.f << ", " << std::setw(10)
+              << float(allocs) / NTASKS << std::endl;
+}
+
+void _testPost(lunchbox::ThreadPool& pool)
+{
+    std::vector<std::future<void> > futures;
+    futures.reserve(BATCH);
+
+    // the first batch fills the memory pool, only measure the steady state
+    size_t allocations = 0;
+    lunchbox::Clock clock;
+    for (size_t i = 0; i < NTASKS + BATCH; i += BATCH)
+    {
+        if (i == BATCH)
+        {
+            allocations = _allocations;
+            clock.reset();
+        }
+        for (size_t j = 0; j < BATCH; ++j)
+            futures.push_back(pool.post([] {}));
+        for (std::future<void>& future : futures)
+            future.get();
+        futures.clear();
+    }
+    _report("post", clock.getTimef(), _allocations - allocations);
+}
+
+void _testPostDetached(lunchbox::ThreadPool& pool)
+{
+    std::atomic<size_t> done(0);
+
+    size_t allocations = 0;
+    lunchbox::Clock clock;
+    for (size_t i = 0; i < NTASKS + BATCH; i += BATCH)
+    {
+        if (i == BATCH)
+        {
+            allocations = _allocations;
+            clock.reset();
+        }
+        for (size_t j = 0; j < BATCH; ++j)
+            pool.postDetached([&done] { ++done; });
+        while (done < i + BATCH)
+            lunchbox::Thread::yield();
+    }
+    _report("postDetached", clock.getTimef(), _allocations - allocations);
+}
+
+int main(int argc, char** argv)
+{
+    TEST(lunchbox::init(argc, argv));
+
+    lunchbox::ThreadPool& pool = lunchbox::ThreadPool::getInstance();
+    std::cout << pool.getSize() << " threads" << std::endl
+              << "      Method,      tasks/s, allocs/task" << std::endl;
+    _testPost(pool);
+    _testPostDetached(pool);
+
+    TEST(lunchbox::exit());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/clock.h>
+#include <lunchbox/mtQueue.h>
+#include <lunchbox/queueSelector.h>
+#include <lunchbox/sleep.h>
+#include <lunchbox/test.h>
+#include <lunchbox/thread.h>
+
+#include <string>
+
+#define NOPS 10000
+
+lunchbox::MTQueue<uint64_t> numbers;
+lunchbox::MTQueue<std::string> strings;
+
+class WriteThread : public lunchbox::Thread
+{
+public:
+    virtual void run()
+    {
+        for (uint64_t i = 0; i < NOPS; ++i)
+        {
+            if (i % 3 == 0)
+                strings.push(std::to_string(i));
+            else
+                numbers.push(i);
+            if (i % 1000 == 0)
+                lunchbox::sleep(1); // let the reader fall asleep
+        }
+        strings.push("done");
+    }
+};
+
+void testFairness()
+{
+    lunchbox::MTQueue<int> first;
+    lunchbox::MTQueue<int> second;
+    lunchbox::QueueSelector selector;
+    TEST(selector.add(first) == 0);
+    TEST(selector.add(second) == 1);
+    TEST(selector.getSize() == 2);
+
+    size_t index = 42;
+    lunchbox::Clock clock;
+    TEST(!selector.timedWait(50, index));
+    TEST(clock.getTime64() >= 45);
+    TEST(index == 42);
+
+    // both ready: the selector alternates, even if nothing is popped
+    first.push(1);
+    second.push(2);
+    TEST(selector.wait() == 0);
+    TEST(selector.wait() == 1);
+    TEST(selector.wait() == 0);
+    TEST(first.pop() == 1);
+    TEST(selector.timedWait(0, index));
+    TEST(index == 1);
+    TEST(second.pop() == 2);
+    TEST(!selector.timedWait(0, index));
+}
+
+int main(int, char**)
+{
+    testFairness();
+
+    lunchbox::QueueSelector selector;
+    const size_t numbersIndex = selector.add(numbers);
+    const size_t stringsIndex = selector.add(strings);
+
+    WriteThread writer;
+    TEST(writer.start());
+
+    size_t nNumbers = 0;
+    size_t nStrings = 0;
+    for (;;)
+    {
+        const size_t index = selector.wait();
+        if (index == numbersIndex)
+        {
+            uint64_t number = 0;
+            TEST(numbers.tryPop(number));
+            TEST(number % 3 != 0);
+            ++nNumbers;
+            continue;
+        }
+
+        TEST(index == stringsIndex);
+        std::string string;
+        TEST(strings.tryPop(string));
+        if (string == "done")
+            break;
+        TEST(std::stoull(string) % 3 == 0);
+        ++nStrings;
+    }
+    TEST(writer.join());
+
+    // the round-robin scan may report "done" before all numbers are popped
+    uint64_t number = 0;
+    while (numbers.tryPop(number))
+        ++nNumbers;
+    TEST(numbers.isEmpty());
+    TEST(strings.isEmpty());
+    TESTINFO(nNumbers + nStrings == NOPS, nNumbers << " + " << nStrings);
+    return EXIT_SUCCESS;
+}
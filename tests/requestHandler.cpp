@@ -21,8 +21,18 @@
 #include <lunchbox/requestHandler.h>
 #include <lunchbox/sleep.h>
 #include <lunchbox/thread.h>
+#include <lunchbox/threadPool.h>
 #include <servus/uint128_t.h>
 
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
 using servus::uint128_t;
 
 lunchbox::RequestHandler handler_;
@@ -66,8 +76,474 @@ public:
     }
 };
 
+void testRegistry()
+{
+    lunchbox::RequestHandler handler;
+    int data = 0;
+    const uint32_t stale = handler.registerRequest(&data);
+    handler.unregisterRequest(stale);
+    TEST(!handler.hasPendingRequests());
+
+    // the slot is recycled with a new identifier
+    const uint32_t request = handler.registerRequest(&data);
+    TEST(request != stale);
+    TEST(handler.getRequestData(stale) == 0);
+    TEST(handler.getRequestData(request) == &data);
+    handler.serveRequest(stale, uint32_t(17));
+    TEST(!handler.isRequestReady(request));
+    handler.serveRequest(request, uint32_t(42));
+    TEST(handler.isRequestReady(request));
+
+    // served, but unregistered without waiting
+    handler.unregisterRequest(request);
+    const uint32_t next = handler.registerRequest();
+    TEST(!handler.isRequestReady(next));
+    handler.unregisterRequest(next);
+
+    // many requests in flight from several threads
+    static const size_t nThreads = 4;
+    static const size_t nRequests = 2000;
+    lunchbox::MTQueue<uint32_t> requests;
+    std::vector<std::thread> servers;
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        servers.emplace_back([&handler, &requests] {
+            for (;;)
+            {
+                const uint32_t id = requests.pop();
+                if (id == 0)
+                    return;
+                const size_t value = size_t(handler.getRequestData(id));
+                handler.serveRequest(id, uint32_t(value));
+            }
+        });
+    }
+
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        clients.emplace_back([&handler, &requests, i] {
+            std::vector<uint32_t> ids;
+            for (size_t j = 1; j <= nRequests; ++j)
+            {
+                const size_t value = i * nRequests + j;
+                ids.push_back(handler.registerRequest((void*)value));
+                requests.push(ids.back());
+            }
+            for (size_t j = 1; j <= nRequests; ++j)
+            {
+                uint32_t result = 0;
+                TEST(handler.waitRequest(ids[j - 1], result));
+                TEST(result == i * nRequests + j);
+            }
+        });
+    }
+    for (std::thread& client : clients)
+        client.join();
+    for (size_t i = 0; i < nThreads; ++i)
+        requests.push(0);
+    for (std::thread& server : servers)
+        server.join();
+    TEST(!handler.hasPendingRequests());
+}
+
+void testIdentifiers()
+{
+    // Sequential requests reuse the same few records. Their identifiers must
+    // not repeat soon, or a late serve of an abandoned request would be
+    // delivered to an unrelated one.
+    lunchbox::RequestHandler handler;
+    const uint32_t abandoned = handler.registerRequest();
+    handler.unregisterRequest(abandoned);
+
+    std::unordered_set<uint32_t> ids;
+    ids.insert(abandoned);
+    for (size_t i = 0; i < 100000; ++i)
+    {
+        const uint32_t request = handler.registerRequest();
+        TESTINFO(ids.insert(request).second,
+                 "Request " << request << " repeated after " << i);
+        handler.serveRequest(abandoned, uint32_t(1));
+        TEST(!handler.isRequestReady(request));
+        handler.unregisterRequest(request);
+    }
+    TEST(!handler.hasPendingRequests());
+}
+
+struct Counted
+{
+    static int instances;
+    Counted() { ++instances; }
+    Counted(const Counted&) { ++instances; }
+    Counted& operator=(const Counted&) = default;
+    ~Counted() { --instances; }
+    uint64_t payload[32]; // larger than the inline storage
+};
+int Counted::instances = 0;
+
+void testTypedResults()
+{
+    lunchbox::RequestHandler handler;
+
+    const std::string hello("Hello, typed world, longer than SSO buffers");
+    lunchbox::Request<std::string> string =
+        handler.registerRequest<std::string>();
+    handler.serveRequest(string.getID(), hello);
+    TEST(string.wait() == hello);
+    TEST(string.wait() == hello);
+
+    lunchbox::Request<std::unique_ptr<int> > unique =
+        handler.registerRequest<std::unique_ptr<int> >();
+    handler.serveRequest(unique.getID(), std::unique_ptr<int>(new int(42)));
+    std::unique_ptr<int> ptr = unique.wait();
+    TEST(ptr && *ptr == 42);
+
+    uint32_t request = handler.registerRequest();
+    std::vector<int> vector(100, 17);
+    handler.serveRequest(request, std::move(vector));
+    std::vector<int> result;
+    TEST(handler.waitRequest(request, result));
+    TEST(result.size() == 100 && result[99] == 17);
+
+    {
+        lunchbox::Request<Counted> counted =
+            handler.registerRequest<Counted>();
+        handler.serveRequest(counted.getID(), Counted());
+        TEST(Counted::instances == 2); // local result and served value
+        counted.wait();
+        TEST(Counted::instances == 1);
+    }
+    TEST(Counted::instances == 0);
+
+    // served, but never retrieved
+    request = handler.registerRequest();
+    handler.serveRequest(request, Counted());
+    TEST(Counted::instances == 1);
+    handler.unregisterRequest(request);
+    TEST(Counted::instances == 0);
+
+    {
+        lunchbox::RequestHandler destroyed;
+        destroyed.serveRequest(destroyed.registerRequest(), Counted());
+        TEST(Counted::instances == 1);
+    }
+    TEST(Counted::instances == 0);
+
+    request = handler.registerRequest();
+    std::string timedOut;
+    TEST(!handler.waitRequest(request, timedOut, 1));
+    handler.unregisterRequest(request);
+    TEST(!handler.hasPendingRequests());
+
+    // a result of another kind fails the wait and is discarded
+    request = handler.registerRequest();
+    handler.serveRequest(request, Counted());
+    uint32_t untyped = 0;
+    TEST(!handler.waitRequest(request, untyped));
+    TEST(Counted::instances == 0);
+
+    request = handler.registerRequest();
+    handler.serveRequest(request, uint32_t(42));
+    TEST(!handler.waitRequest(request, timedOut));
+
+    request = handler.registerRequest();
+    handler.serveRequest(request, std::vector<int>(1, 17));
+    TEST(!handler.waitRequest(request, timedOut));
+    TEST(!handler.hasPendingRequests());
+}
+
+void testBatches()
+{
+    lunchbox::RequestHandler handler;
+    std::vector<uint32_t> requests;
+    for (uint32_t i = 0; i < 8; ++i)
+        requests.push_back(handler.registerRequest());
+
+    TEST(handler.waitAny(requests, 1) == requests.size());
+    TEST(!handler.waitAll(requests, 1));
+
+    handler.serveRequest(requests[5], uint32_t(5));
+    TEST(handler.waitAny(requests, 1) == 5);
+    TEST(!handler.waitAll(requests, 1));
+
+    // the batch wakes the parked waiter, results are retrieved afterwards
+    std::vector<uint32_t> results;
+    for (uint32_t i = 0; i < 8; ++i)
+        results.push_back(i);
+    std::thread server([&handler, &requests, &results] {
+        lunchbox::sleep(10);
+        handler.serveRequests(requests, results);
+    });
+    TEST(handler.waitAll(requests));
+    server.join();
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        uint32_t result = 0;
+        TEST(handler.waitRequest(requests[i], result, 0));
+        TESTINFO(result == i, result << " != " << i);
+    }
+    TEST(!handler.hasPendingRequests());
+
+    // unknown requests are ignored by waitAny and complete for waitAll
+    TEST(handler.waitAll(requests, 0));
+    TEST(handler.waitAny(requests, 0) == requests.size());
+
+    // typed results, served from another thread while waiting for any
+    requests.clear();
+    for (size_t i = 0; i < 4; ++i)
+        requests.push_back(handler.registerRequest());
+    std::thread typedServer([&handler, &requests] {
+        lunchbox::sleep(10);
+        std::vector<std::string> strings(requests.size(), "served");
+        handler.serveRequests(requests, std::move(strings));
+    });
+    TEST(handler.waitAny(requests) < requests.size());
+    typedServer.join();
+    for (const uint32_t request : requests)
+    {
+        std::string result;
+        TEST(handler.waitRequest(request, result, 0));
+        TEST(result == "served");
+    }
+
+    // a request watched by waitAny may later be waited for on its own
+    const uint32_t request = handler.registerRequest();
+    TEST(handler.waitAny(std::vector<uint32_t>(1, request), 1) == 1);
+    std::thread single([&handler, request] {
+        lunchbox::sleep(10);
+        handler.serveRequests(std::vector<uint32_t>(1, request));
+    });
+    TEST(handler.waitRequest(request));
+    single.join();
+    TEST(!handler.hasPendingRequests());
+
+    // a throwing continuation ends the batch, later serves still wake
+    const uint32_t throwing = handler.registerRequest();
+    handler.setContinuation(throwing, [&handler, throwing] {
+        handler.unregisterRequest(throwing);
+        throw std::runtime_error("continuation failed");
+    });
+    try
+    {
+        handler.serveRequests(std::vector<uint32_t>(1, throwing));
+        TESTINFO(false, "Missing exception");
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+
+    const uint32_t next = handler.registerRequest();
+    std::thread waiter([&handler, next] {
+        const auto start = std::chrono::steady_clock::now();
+        TEST(handler.waitAny(std::vector<uint32_t>(1, next), 5000) == 0);
+        TEST(std::chrono::steady_clock::now() - start <
+             std::chrono::seconds(2));
+    });
+    lunchbox::sleep(10);
+    handler.serveRequest(next);
+    waiter.join();
+    TEST(handler.waitRequest(next));
+    TEST(!handler.hasPendingRequests());
+
+    // a timed out waitRequest does not hide the request from waitAny
+    const uint32_t timedOut = handler.registerRequest();
+    uint32_t unused = 0;
+    TEST(!handler.waitRequest(timedOut, unused, 5));
+    std::thread late([&handler, timedOut] {
+        lunchbox::sleep(50);
+        handler.serveRequest(timedOut);
+    });
+    const auto start = std::chrono::steady_clock::now();
+    TEST(handler.waitAny(std::vector<uint32_t>(1, timedOut), 2000) == 0);
+    TEST(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    late.join();
+    TEST(handler.waitRequest(timedOut));
+    TEST(!handler.hasPendingRequests());
+}
+
+void testContinuations()
+{
+    lunchbox::RequestHandler handler;
+
+    // executed by the serving thread
+    uint32_t value = 0;
+    {
+        lunchbox::Request<uint32_t> request =
+            handler.registerRequest<uint32_t>();
+        request.then([&value](const uint32_t result) { value = result; });
+        TEST(value == 0);
+        handler.serveRequest(request.getID(), uint32_t(42));
+        TEST(value == 42);
+        TEST(!handler.hasPendingRequests());
+        try
+        {
+            request.wait();
+            TESTINFO(false, "Missing exception");
+        }
+        catch (const lunchbox::UnregisteredRequest&)
+        {
+        }
+    } // does not wait
+
+    // already served, executed by the calling thread
+    bool served = false;
+    lunchbox::Request<void> request = handler.registerRequest<void>();
+    handler.serveRequest(request.getID());
+    request.then([&served] { served = true; });
+    TEST(served);
+    TEST(!handler.hasPendingRequests());
+
+    // routed to a thread pool
+    lunchbox::ThreadPool pool(1);
+    std::promise<std::string> promise;
+    lunchbox::Request<std::string> string =
+        handler.registerRequest<std::string>();
+    string.then(pool, [&promise](std::string&& result) {
+        promise.set_value(std::move(result));
+    });
+    std::thread server([&handler, &string] {
+        handler.serveRequest(string.getID(), std::string("continued"));
+    });
+    TEST(promise.get_future().get() == "continued");
+    server.join();
+
+    // routed to a queue, served as a batch
+    lunchbox::MTQueue<std::unique_ptr<int> > queue;
+    std::vector<uint32_t> requests;
+    for (int i = 0; i < 4; ++i)
+    {
+        lunchbox::Request<std::unique_ptr<int> > unique =
+            handler.registerRequest<std::unique_ptr<int> >();
+        unique.then(queue);
+        requests.push_back(unique.getID());
+    }
+    std::vector<std::unique_ptr<int> > results;
+    for (int i = 0; i < 4; ++i)
+        results.emplace_back(new int(i));
+    handler.serveRequests(requests, std::move(results));
+    for (int i = 0; i < 4; ++i)
+    {
+        std::unique_ptr<int> result = queue.pop();
+        TEST(result && *result == i);
+    }
+    TEST(!handler.hasPendingRequests());
+}
+
+void testDeadlines()
+{
+    lunchbox::RequestHandler handler;
+
+    // expired by an explicit sweep
+    int data = 0;
+    uint32_t request = handler.registerRequest(&data, 10);
+    TEST(handler.getStatistics().outstanding == 1);
+    TEST(handler.expireRequests() == 0);
+    lunchbox::sleep(30);
+    TEST(handler.expireRequests() == 1);
+    TEST(!handler.hasPendingRequests());
+    TEST(handler.getRequestData(request) == 0);
+    TEST(!handler.waitRequest(request));
+
+    // a late reply is ignored
+    handler.serveRequest(request, uint32_t(42));
+    lunchbox::RequestHandler::Statistics statistics = handler.getStatistics();
+    TEST(statistics.outstanding == 0);
+    TEST(statistics.served == 0);
+    TEST(statistics.expired == 1);
+
+    // a parked waiter fails at the deadline without a sweep
+    request = handler.registerRequest(nullptr, 20);
+    TEST(!handler.waitRequest(request));
+    TEST(!handler.hasPendingRequests());
+    TEST(handler.getStatistics().expired == 2);
+
+    // served in time, the stale deadline is ignored
+    request = handler.registerRequest(nullptr, 10);
+    handler.serveRequest(request, uint32_t(17));
+    uint32_t result = 0;
+    TEST(handler.waitRequest(request, result));
+    TEST(result == 17);
+    lunchbox::sleep(30);
+    TEST(handler.expireRequests() == 0);
+    statistics = handler.getStatistics();
+    TEST(statistics.served == 1);
+    TEST(statistics.expired == 2);
+
+    // expired by the sweep in hasPendingRequests()
+    request = handler.registerRequest(nullptr, 10);
+    lunchbox::sleep(30);
+    TEST(!handler.hasPendingRequests());
+
+    // futures and continuations
+    {
+        lunchbox::Request<uint32_t> future =
+            handler.registerRequest<uint32_t>(nullptr, 10);
+        try
+        {
+            future.wait();
+            TESTINFO(false, "Missing exception");
+        }
+        catch (const lunchbox::FutureTimeout&)
+        {
+        }
+
+        lunchbox::Request<uint32_t> unwaited =
+            handler.registerRequest<uint32_t>(nullptr, 10);
+        bool called = false;
+        lunchbox::Request<uint32_t> continued =
+            handler.registerRequest<uint32_t>(nullptr, 10);
+        continued.then([&called](uint32_t) { called = true; });
+
+        // the expiring thread reports the failure, and may register requests
+        uint32_t nested = 0;
+        lunchbox::Request<uint32_t> failed =
+            handler.registerRequest<uint32_t>(nullptr, 10);
+        failed.then([&called](uint32_t) { called = true; },
+                    [&handler, &nested] {
+                        nested = handler.registerRequest(nullptr, 1000);
+                    });
+        lunchbox::sleep(30);
+        TEST(handler.expireRequests() == 3);
+        TEST(!called);
+        TEST(nested != 0);
+        handler.unregisterRequest(nested);
+    } // does not block or throw on expired requests
+    TEST(!handler.hasPendingRequests());
+    TEST(handler.getStatistics().expired == 7);
+
+    lunchbox::Request<void> late = handler.registerRequest<void>(nullptr, 10);
+    lunchbox::sleep(30);
+    TEST(handler.expireRequests() == 1);
+    try
+    {
+        late.then([] {});
+        TESTINFO(false, "Missing exception");
+    }
+    catch (const lunchbox::UnregisteredRequest&)
+    {
+    }
+
+    // parked waitAll and waitAny fail at the deadline without a sweep
+    const uint64_t expired = handler.getStatistics().expired;
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> requests(1, handler.registerRequest(nullptr, 20));
+    TEST(!handler.waitAll(requests));
+    requests.push_back(handler.registerRequest(nullptr, 20));
+    TEST(handler.waitAny(requests) == requests.size());
+    TEST(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    TEST(!handler.hasPendingRequests());
+    TEST(handler.getStatistics().expired == expired + 2);
+}
+
 int main(int, char**)
 {
+    testRegistry();
+    testIdentifiers();
+    testTypedResults();
+    testBatches();
+    testContinuations();
+    testDeadlines();
+
     uint8_t* payload = (uint8_t*)42;
     Thread thread;
     thread.start();
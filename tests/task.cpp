@@ -0,0 +1,90 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/task.h>
+#include <lunchbox/test.h>
+
+#include <array>
+#include <memory>
+#include <thread>
+#include <vector>
+
+size_t _calls = 0;
+
+void _function()
+{
+    ++_calls;
+}
+
+struct MoveOnly
+{
+    std::unique_ptr<size_t> value;
+    size_t* result;
+
+    void operator()() { *result = *value; }
+};
+
+int main(int, char**)
+{
+    lunchbox::Task empty;
+    TEST(!empty);
+
+    // function pointer and small lambda, stored inline
+    lunchbox::Task task(&_function);
+    TEST(task);
+    task();
+    TEST(_calls == 1);
+
+    size_t value = 0;
+    task = [&value] { value = 42; };
+    task();
+    TEST(value == 42);
+
+    // move-only state
+    lunchbox::Task moveOnly(
+        MoveOnly{std::unique_ptr<size_t>(new size_t(17)), &value});
+    lunchbox::Task moved(std::move(moveOnly));
+    TEST(!moveOnly);
+    moved();
+    TEST(value == 17);
+
+    // large state, stored in the task memory pool
+    std::array<size_t, 32> array;
+    array.fill(3);
+    lunchbox::Task large([&value, array] { value = array[31]; });
+    moved = std::move(large);
+    TEST(!large);
+    moved();
+    TEST(value == 3);
+    moved = nullptr;
+    TEST(!moved);
+
+    // memory freed from another thread is reused
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 1000; ++i)
+        blocks.push_back(lunchbox::allocateTaskMemory(100));
+    std::thread thread([&blocks] {
+        for (void* block : blocks)
+            lunchbox::freeTaskMemory(block, 100);
+    });
+    thread.join();
+    for (size_t i = 0; i < 1000; ++i)
+        blocks[i] = lunchbox::allocateTaskMemory(100);
+    for (void* block : blocks)
+        lunchbox::freeTaskMemory(block, 100);
+    return EXIT_SUCCESS;
+}
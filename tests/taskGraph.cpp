@@ -0,0 +1,132 @@
+
+/* Copyright (c) 2019, Stefan Eilemann <eile@equalizergraphics.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <lunchbox/taskGraph.h>
+#include <lunchbox/test.h>
+
+#include <atomic>
+#include <stdexcept>
+
+#define NFRAMES 100
+
+void testDiamond(lunchbox::ThreadPool& pool)
+{
+    // a -> (b, c) -> d, d sees the results of all previous stages
+    std::atomic<int> a(0), b(0), c(0);
+    int d = 0;
+
+    lunchbox::TaskGraph graph(pool);
+    const lunchbox::TaskGraph::Node nodeA = graph.add([&a] { a = 1; });
+    const lunchbox::TaskGraph::Node nodeB =
+        graph.then(nodeA, [&a, &b] { b = a + 1; });
+    const lunchbox::TaskGraph::Node nodeC =
+        graph.then(nodeA, [&a, &c] { c = a + 2; });
+    const lunchbox::TaskGraph::Node nodeD =
+        graph.whenAll({nodeB, nodeC}, [&] { d = a + b + c; });
+    TEST(graph.getSize() == 4);
+    TEST(!graph.isDone(nodeD));
+
+    graph.run();
+    graph.wait();
+    TEST(graph.isDone(nodeD));
+    TEST(d == 6);
+
+    // continuation of a completed node is posted directly
+    std::atomic<bool> late(false);
+    graph.then(nodeD, [&late] { late = true; });
+    graph.wait();
+    TEST(late);
+}
+
+void testAny(lunchbox::ThreadPool& pool)
+{
+    std::atomic<int> first(0);
+    std::atomic<int> any(0);
+
+    lunchbox::TaskGraph graph(pool);
+    std::vector<lunchbox::TaskGraph::Node> nodes;
+    for (int i = 1; i <= 4; ++i)
+        nodes.push_back(graph.add([&first, i] {
+            int expected = 0;
+            first.compare_exchange_strong(expected, i);
+        }));
+    graph.whenAny(nodes, [&first, &any] { any = first.load(); });
+    graph.wait();
+    TEST(any != 0);
+}
+
+void testException(lunchbox::ThreadPool& pool)
+{
+    std::atomic<bool> executed(false);
+    std::atomic<bool> anyExecuted(false);
+
+    lunchbox::TaskGraph graph(pool);
+    const lunchbox::TaskGraph::Node fail =
+        graph.add([] { throw std::runtime_error("test"); });
+    const lunchbox::TaskGraph::Node ok = graph.add([] {});
+    const lunchbox::TaskGraph::Node skipped =
+        graph.then(fail, [&executed] { executed = true; });
+    graph.whenAny({fail, ok}, [&anyExecuted] { anyExecuted = true; });
+    try
+    {
+        graph.wait();
+        TEST(false);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    TEST(graph.isDone(skipped));
+    TEST(!executed);
+    TEST(anyExecuted);
+}
+
+void testPipeline(lunchbox::ThreadPool& pool)
+{
+    // frame i: decode -> process -> present, present i after present i-1
+    std::atomic<size_t> presented(0);
+    std::atomic<bool> ordered(true);
+
+    lunchbox::TaskGraph graph(pool);
+    graph.run();
+    lunchbox::TaskGraph::Node previous = graph.add([] {});
+    for (size_t i = 0; i < NFRAMES; ++i)
+    {
+        const auto decode = graph.add([] {});
+        const auto process = graph.then(decode, [] {});
+        previous = graph.whenAll({process, previous}, [&, i] {
+            if (presented++ != i)
+                ordered = false;
+        });
+    }
+    graph.wait();
+    TEST(presented == NFRAMES);
+    TEST(ordered);
+}
+
+int main(int, char**)
+{
+    lunchbox::ThreadPool pool(4);
+    testDiamond(pool);
+    testAny(pool);
+    testException(pool);
+    testPipeline(pool);
+
+    lunchbox::ThreadPool single(1);
+    testDiamond(single);
+    testPipeline(single);
+    return EXIT_SUCCESS;
+}
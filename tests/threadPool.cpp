@@ -19,6 +19,13 @@
 
 #include <lunchbox/threadPool.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
 BOOST_AUTO_TEST_CASE(size)
 {
     lunchbox::ThreadPool threadPool{3};
@@ -81,9 +88,474 @@ BOOST_AUTO_TEST_CASE(join)
         }
     } // blocks until all tasks are done
 
-    for (const std::future<int>& future : futures)
+    for (std::future<int>& future : futures)
     {
         BOOST_CHECK(future.wait_for(std::chrono::milliseconds(0)) ==
                     std::future_status::ready);
+        BOOST_CHECK_EQUAL(future.get(), 42);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(waitIdle)
+{
+    lunchbox::ThreadPool threadPool{2};
+    std::atomic<size_t> done(0);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        threadPool.postDetached([&threadPool, &done] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // nested tasks are waited for as well
+            threadPool.postDetached([&done] { ++done; });
+        });
+    }
+    BOOST_CHECK(!threadPool.waitIdle(0));
+    BOOST_CHECK(threadPool.waitIdle());
+    BOOST_CHECK_EQUAL(done, 10);
+
+    for (size_t i = 0; i < 100; ++i)
+        threadPool.postDetached([&done] { ++done; });
+    threadPool.drain();
+    BOOST_CHECK_EQUAL(done, 110);
+    BOOST_CHECK(!threadPool.hasPendingJobs());
+}
+
+BOOST_AUTO_TEST_CASE(resize)
+{
+    lunchbox::ThreadPool threadPool{1};
+    threadPool.resize(4);
+    BOOST_CHECK_EQUAL(threadPool.getSize(), 4);
+    BOOST_CHECK_EQUAL(threadPool.getRunningThreads(), 4);
+
+    std::vector<std::future<int> > futures;
+    for (size_t i = 0; i < 20; ++i)
+        futures.push_back(threadPool.post(task));
+    threadPool.resize(2);
+    BOOST_CHECK_EQUAL(threadPool.getSize(), 2);
+    BOOST_CHECK_EQUAL(threadPool.getRunningThreads(), 2);
+    for (auto& future : futures)
+        BOOST_CHECK_EQUAL(future.get(), 42);
+
+    threadPool.resize(3);
+    BOOST_CHECK_EQUAL(threadPool.getRunningThreads(), 3);
+    BOOST_CHECK_EQUAL(threadPool.post(task).get(), 42);
+}
+
+#ifdef __linux__
+size_t _countThreads()
+{
+    DIR* dir = opendir("/proc/self/task");
+    size_t count = 0;
+    while (readdir(dir))
+        ++count;
+    closedir(dir);
+    return count - 2; // . and ..
+}
+
+// Stopped workers exit without waiting for the reuse of their slot or the
+// pool destruction
+void _checkThreads(const size_t expected)
+{
+    for (size_t i = 0; i < 100 && _countThreads() != expected; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_CHECK_EQUAL(_countThreads(), expected);
+}
+#else
+void _checkThreads(const size_t) {}
+#endif
+
+BOOST_AUTO_TEST_CASE(releaseThreads)
+{
+#ifdef __linux__
+    const size_t threads = _countThreads();
+#else
+    const size_t threads = 0;
+#endif
+    lunchbox::ThreadPool threadPool{4};
+    _checkThreads(threads + 4);
+    threadPool.resize(1);
+    _checkThreads(threads + 1);
+    threadPool.setIdleTimeout(10);
+    _checkThreads(threads);
+    BOOST_CHECK_EQUAL(threadPool.post(task).get(), 42);
+}
+
+BOOST_AUTO_TEST_CASE(emptyPool)
+{
+    // a pool keeps at least one thread to run its tasks
+    lunchbox::ThreadPool threadPool{0};
+    BOOST_CHECK_EQUAL(threadPool.getSize(), 1);
+    BOOST_CHECK_EQUAL(threadPool.post(task).get(), 42);
+
+    threadPool.resize(0);
+    BOOST_CHECK_EQUAL(threadPool.getSize(), 1);
+    BOOST_CHECK_EQUAL(threadPool.post(task).get(), 42);
+    BOOST_CHECK(threadPool.waitIdle());
+}
+
+BOOST_AUTO_TEST_CASE(idleTimeout)
+{
+    lunchbox::ThreadPool threadPool{3};
+    threadPool.setIdleTimeout(10);
+    BOOST_CHECK_EQUAL(threadPool.getIdleTimeout(), 10);
+    for (size_t i = 0; i < 100 && threadPool.getRunningThreads() > 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_CHECK_EQUAL(threadPool.getRunningThreads(), 0);
+    BOOST_CHECK_EQUAL(threadPool.getSize(), 3);
+
+    // threads are restarted on demand
+    BOOST_CHECK_EQUAL(threadPool.post(task).get(), 42);
+    BOOST_CHECK(threadPool.getRunningThreads() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(steal)
+{
+    // Nested tasks are queued on the posting worker. While it blocks on their
+    // futures, they have to be stolen by the other worker.
+    lunchbox::ThreadPool threadPool{2};
+    auto parent = threadPool.post([&threadPool] {
+        std::vector<std::future<size_t> > children;
+        for (size_t i = 0; i < 100; ++i)
+            children.push_back(threadPool.post([i] { return i; }));
+
+        size_t sum = 0;
+        for (auto& child : children)
+            sum += child.get();
+        return sum;
+    });
+    BOOST_CHECK_EQUAL(parent.get(), 4950);
+    BOOST_CHECK(!threadPool.hasPendingJobs());
+}
+
+BOOST_AUTO_TEST_CASE(exception)
+{
+    lunchbox::ThreadPool threadPool{1};
+    auto future = threadPool.post([]() -> int { throw std::runtime_error(""); });
+    BOOST_CHECK_THROW(future.get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(numa)
+{
+    const size_t numNodes = lunchbox::ThreadPool::getNumNodes();
+    BOOST_CHECK_GE(numNodes, 1);
+    BOOST_CHECK_EQUAL(lunchbox::ThreadPool::getCurrentNode(), -1);
+
+    for (size_t i = 0; i < numNodes; ++i)
+    {
+        const int32_t node = int32_t(i);
+        lunchbox::ThreadPool threadPool{2, node};
+        BOOST_CHECK_EQUAL(threadPool.getSize(), 2);
+        BOOST_CHECK_EQUAL(threadPool.post(lunchbox::ThreadPool::getCurrentNode)
+                              .get(),
+                          node);
+    }
+
+    lunchbox::ThreadPool threadPool{0, lunchbox::ThreadPool::ALL_NODES};
+    BOOST_CHECK_GE(threadPool.getSize(), numNodes);
+    std::vector<std::future<int32_t> > futures;
+    for (size_t i = 0; i < numNodes; ++i)
+        futures.push_back(
+            threadPool.post(lunchbox::ThreadPool::getCurrentNode, i));
+    for (auto& future : futures)
+    {
+        const int32_t node = future.get();
+        BOOST_CHECK_GE(node, 0);
+        BOOST_CHECK_LT(node, int32_t(numNodes));
+    }
+
+    lunchbox::ThreadPool unpinned{1, lunchbox::ThreadPool::UNPINNED};
+    BOOST_CHECK_EQUAL(unpinned.post(lunchbox::ThreadPool::getCurrentNode, 0)
+                          .get(),
+                      -1);
+}
+
+namespace
+{
+// Occupies the single worker of a pool until release() is called
+class Blocker
+{
+public:
+    explicit Blocker(lunchbox::ThreadPool& pool)
+    {
+        std::shared_future<void> released = _release.get_future().share();
+        std::shared_ptr<std::promise<void> > started =
+            std::make_shared<std::promise<void> >();
+        pool.postDetached([released, started] {
+            started->set_value();
+            released.wait();
+        });
+        started->get_future().wait();
     }
+
+    void release() { _release.set_value(); }
+private:
+    std::promise<void> _release;
+};
+
+// Records the execution order of tasks
+class Order
+{
+public:
+    std::function<void()> add(const int value)
+    {
+        return [this, value] {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _values.push_back(value);
+        };
+    }
+
+    std::vector<int> get()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _values;
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<int> _values;
+};
+}
+
+BOOST_AUTO_TEST_CASE(priorities)
+{
+    typedef lunchbox::ThreadPool Pool;
+    Pool threadPool{1};
+    threadPool.setStarvationTimeout(LB_TIMEOUT_INDEFINITE);
+    Order order;
+    Blocker blocker(threadPool);
+
+    threadPool.postDetached(order.add(6), Pool::PRIORITY_LOW);
+    threadPool.postDetached(order.add(4));
+    threadPool.postDetached(order.add(5), Pool::PRIORITY_NORMAL);
+    threadPool.postDetached(order.add(3), Pool::PRIORITY_NORMAL, 1000);
+    threadPool.postDetached(order.add(2), Pool::PRIORITY_NORMAL, 10);
+    threadPool.post(order.add(1), Pool::PRIORITY_HIGH);
+
+    const Pool::Statistics normal =
+        threadPool.getStatistics(Pool::PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(normal.queued, 4);
+    BOOST_CHECK_EQUAL(threadPool.getStatistics(Pool::PRIORITY_HIGH).queued, 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    blocker.release();
+    BOOST_CHECK(threadPool.waitIdle());
+    BOOST_CHECK(order.get() == std::vector<int>({1, 2, 3, 4, 5, 6}));
+
+    const Pool::Statistics low = threadPool.getStatistics(Pool::PRIORITY_LOW);
+    BOOST_CHECK_EQUAL(low.queued, 0);
+    BOOST_CHECK_EQUAL(low.started, 1);
+    BOOST_CHECK_GE(low.maxWait, 10.f);
+    BOOST_CHECK_GE(low.averageWait, 10.f);
+    // including the blocker
+    BOOST_CHECK_EQUAL(threadPool.getStatistics(Pool::PRIORITY_NORMAL).started,
+                      5);
+}
+
+BOOST_AUTO_TEST_CASE(starvation)
+{
+    typedef lunchbox::ThreadPool Pool;
+    Pool threadPool{1};
+    threadPool.setStarvationTimeout(10);
+    BOOST_CHECK_EQUAL(threadPool.getStarvationTimeout(), 10);
+    Order order;
+    Blocker blocker(threadPool);
+
+    threadPool.postDetached(order.add(2), Pool::PRIORITY_LOW);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    threadPool.postDetached(order.add(1), Pool::PRIORITY_HIGH);
+
+    blocker.release();
+    BOOST_CHECK(threadPool.waitIdle());
+    BOOST_CHECK(order.get() == std::vector<int>({2, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(starvationDeadline)
+{
+    typedef lunchbox::ThreadPool Pool;
+    Pool threadPool{1};
+    threadPool.setStarvationTimeout(50);
+    Order order;
+    Blocker blocker(threadPool);
+
+    // the starving task has a later deadline than a recent one of its level
+    threadPool.postDetached(order.add(1), Pool::PRIORITY_LOW, 10000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    threadPool.postDetached(order.add(3), Pool::PRIORITY_LOW, 1);
+    threadPool.postDetached(order.add(2), Pool::PRIORITY_HIGH);
+
+    blocker.release();
+    BOOST_CHECK(threadPool.waitIdle());
+    BOOST_CHECK(order.get() == std::vector<int>({1, 2, 3}));
+}
+
+BOOST_AUTO_TEST_CASE(timers)
+{
+    lunchbox::ThreadPool threadPool{2};
+    const auto start = std::chrono::steady_clock::now();
+    std::promise<std::chrono::steady_clock::time_point> fired;
+    lunchbox::ThreadPool::Timer timer = threadPool.postAfter(20, [&fired] {
+        fired.set_value(std::chrono::steady_clock::now());
+    });
+    BOOST_CHECK(timer.isScheduled());
+    BOOST_CHECK(fired.get_future().get() - start >=
+                std::chrono::milliseconds(20));
+    threadPool.waitIdle();
+    BOOST_CHECK(!timer.isScheduled());
+    BOOST_CHECK(!timer.cancel());
+
+    std::atomic<bool> cancelled(true);
+    timer = threadPool.postAfter(1000, [&cancelled] { cancelled = false; });
+    BOOST_CHECK(timer.cancel());
+    BOOST_CHECK(!timer.cancel());
+    BOOST_CHECK(!timer.isScheduled());
+
+    std::atomic<size_t> count(0);
+    timer = threadPool.postEvery(5, [&count] { ++count; });
+    while (count < 3)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    BOOST_CHECK(timer.cancel());
+    threadPool.waitIdle();
+    const size_t final = count;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BOOST_CHECK_EQUAL(count, final);
+    BOOST_CHECK(cancelled);
+
+    // cancelled during an execution, a periodic task is not rescheduled
+    std::promise<void> running;
+    std::promise<void> resume;
+    std::shared_future<void> resumed = resume.get_future().share();
+    count = 0;
+    timer = threadPool.postEvery(5, [&count, &running, resumed] {
+        if (++count == 1)
+            running.set_value();
+        resumed.wait();
+    });
+    running.get_future().wait();
+    BOOST_CHECK(timer.isScheduled());
+    BOOST_CHECK(timer.cancel());
+    BOOST_CHECK(!timer.cancel());
+    resume.set_value();
+    threadPool.waitIdle();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BOOST_CHECK_EQUAL(count, 1);
+
+    BOOST_CHECK(!lunchbox::ThreadPool::Timer().cancel());
+
+    // cancelling releases the task without waiting for its due time
+    std::shared_ptr<int> captured = std::make_shared<int>(42);
+    timer = threadPool.postAfter(3600000, [captured] {});
+    lunchbox::ThreadPool::Timer periodic =
+        threadPool.postEvery(3600000, [captured] {});
+    BOOST_CHECK_EQUAL(captured.use_count(), 3);
+    BOOST_CHECK(timer.cancel());
+    BOOST_CHECK(periodic.cancel());
+    BOOST_CHECK_EQUAL(captured.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(timerDestruction)
+{
+    std::atomic<bool> executed(false);
+    lunchbox::ThreadPool::Timer timer;
+    {
+        lunchbox::ThreadPool threadPool{1};
+        timer = threadPool.postAfter(1000, [&executed] { executed = true; });
+        threadPool.postEvery(1, [] {});
+    }
+    BOOST_CHECK(!executed);
+    BOOST_CHECK(!timer.isScheduled());
+    BOOST_CHECK(!timer.cancel());
+}
+
+BOOST_AUTO_TEST_CASE(metrics)
+{
+    lunchbox::ThreadPool threadPool{2};
+    for (size_t i = 0; i < 100; ++i)
+    {
+        threadPool.postDetached([i] {
+            if (i % 10 == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        });
+    }
+    BOOST_CHECK(threadPool.waitIdle());
+
+    lunchbox::ThreadPool::Metrics result = threadPool.getMetrics();
+    BOOST_CHECK_EQUAL(result.posted, 100);
+    BOOST_CHECK_EQUAL(result.completed, 100);
+    BOOST_CHECK_EQUAL(result.queued, 0);
+    BOOST_CHECK_GE(result.maxQueued, 1);
+    BOOST_CHECK_LE(result.steals, 100);
+
+    uint64_t waits = 0;
+    uint64_t executions = 0;
+    uint64_t slow = 0;
+    for (size_t i = 0; i < lunchbox::ThreadPool::HISTOGRAM_SIZE; ++i)
+    {
+        waits += result.waitTimes[i];
+        executions += result.executionTimes[i];
+        if (i > 11) // >= 2048 us
+            slow += result.executionTimes[i];
+    }
+    BOOST_CHECK_EQUAL(waits, 100);
+    BOOST_CHECK_EQUAL(executions, 100);
+    BOOST_CHECK_GE(result.executionTimes[11] + slow, 10);
+
+    BOOST_CHECK_EQUAL(result.busyRatios.size(), 2);
+    for (const float ratio : result.busyRatios)
+    {
+        BOOST_CHECK_GE(ratio, 0.f);
+        BOOST_CHECK_LE(ratio, 1.f);
+    }
+
+    // tasks executed by drain() are counted as well
+    Blocker blocker(threadPool);
+    Blocker blocker2(threadPool);
+    for (size_t i = 0; i < 10; ++i)
+        threadPool.postDetached([] {});
+    std::thread release([&blocker, &blocker2] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        blocker.release();
+        blocker2.release();
+    });
+    threadPool.drain();
+    release.join();
+    result = threadPool.getMetrics();
+    BOOST_CHECK_EQUAL(result.posted, 112);
+    BOOST_CHECK_EQUAL(result.completed, 112);
+}
+
+BOOST_AUTO_TEST_CASE(concurrentMetrics)
+{
+    static const size_t nPosters = 8;
+    static const size_t nTasks = 2000;
+    lunchbox::ThreadPool threadPool{nPosters};
+    std::vector<std::thread> posters;
+    for (size_t i = 0; i < nPosters; ++i)
+    {
+        posters.emplace_back([&threadPool] {
+            for (size_t j = 0; j < nTasks; ++j)
+            {
+                threadPool.postDetached([] {});
+                if (j % 100 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    // sampled while posting, a wrapped counter shows up as a huge value
+    for (size_t i = 0; i < 100; ++i)
+    {
+        const lunchbox::ThreadPool::Metrics result = threadPool.getMetrics();
+        BOOST_CHECK_LE(result.queued, nPosters * nTasks);
+        BOOST_CHECK_LE(result.maxQueued, nPosters * nTasks);
+        std::this_thread::yield();
+    }
+    for (std::thread& poster : posters)
+        poster.join();
+    BOOST_CHECK(threadPool.waitIdle());
+
+    const lunchbox::ThreadPool::Metrics result = threadPool.getMetrics();
+    BOOST_CHECK_EQUAL(result.posted, nPosters * nTasks);
+    BOOST_CHECK_EQUAL(result.completed, nPosters * nTasks);
+    BOOST_CHECK_EQUAL(result.queued, 0);
+    BOOST_CHECK_GE(result.maxQueued, 1);
+    BOOST_CHECK_LE(result.maxQueued, nPosters * nTasks);
+    BOOST_CHECK(!threadPool.hasPendingJobs());
 }